@@ -0,0 +1,57 @@
+#version 410 core
+
+out vec4 fColor;
+
+//G-buffer written by gBuffer.frag
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjection;
+uniform mat4 inverseView;
+
+//surface rebuilt from the G-buffer, same names as the inputs of the forward shader
+vec4 fPosWorld = vec4(0.0f);
+vec4 fPosEye = vec4(0.0f);
+vec3 fNormal = vec3(0.0f);
+
+#include "include/lighting.glsl"
+
+vec3 decodeNormal(vec2 encoded) {
+	vec2 f = encoded * 2.0f - 1.0f;
+	vec3 n = vec3(f, 1.0f - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0f, 1.0f);
+	n.xy += vec2(n.x >= 0.0f ? -t : t, n.y >= 0.0f ? -t : t);
+	return normalize(n);
+}
+
+void main() 
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gDepth, pixel, 0).r;
+
+	//eye and world position from the depth
+	vec2 ndc = (gl_FragCoord.xy / vec2(textureSize(gDepth, 0))) * 2.0f - 1.0f;
+	vec4 posEye = inverseProjection * vec4(ndc, depth * 2.0f - 1.0f, 1.0f);
+	fPosEye = vec4(posEye.xyz / posEye.w, 1.0f);
+	fPosWorld = inverseView * fPosEye;
+
+	//the whole quad must still be running, the derivatives are undefined after the discard
+	posWorldDx = dFdx(fPosWorld);
+	posWorldDy = dFdy(fPosWorld);
+	if (depth == 1.0f) {
+		discard; //nothing was drawn here, keep the background for the sky box
+	}
+
+	fNormal = decodeNormal(texelFetch(gNormal, pixel, 0).rg);
+	vec4 albedoSpec = texelFetch(gAlbedoSpec, pixel, 0);
+	diffuseColor = albedoSpec.rgb;
+	specularColor = vec3(albedoSpec.a);
+
+	mainLight = LightStruct(0.5f, 0.5f, 32.0f, mainLightColor, mainLightDir, 0.0f, -1, vec3(0.0f));
+
+	vec3 color = computeMainLight() + computeClusteredLights();
+
+	fColor = applyFog(color, 1.0f);
+	//the windows, light cube and sky box are drawn after this pass and test against the scene depth
+	gl_FragDepth = depth;
+}
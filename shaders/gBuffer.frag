@@ -0,0 +1,28 @@
+#version 410 core
+
+in vec3 fNormal;
+in vec2 fTexCoords;
+
+layout(location = 0) out vec4 gAlbedoSpec;
+layout(location = 1) out vec2 gNormal;
+
+uniform sampler2D diffuseTexture;
+uniform sampler2D specularTexture;
+
+//octahedral mapping of a unit vector to [0, 1]^2
+vec2 encodeNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 folded = n.xy;
+	if (n.z < 0.0f) {
+		folded = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return folded * 0.5f + 0.5f;
+}
+
+void main()
+{
+	//the specular map is reduced to a single intensity
+	vec3 specular = texture(specularTexture, fTexCoords).rgb;
+	gAlbedoSpec = vec4(texture(diffuseTexture, fTexCoords).rgb, dot(specular, vec3(1.0f / 3.0f)));
+	gNormal = encodeNormal(normalize(fNormal));
+}
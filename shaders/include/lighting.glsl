@@ -0,0 +1,262 @@
+//lighting shared by shaderStart.frag and deferredLighting.frag
+//the including shader declares fPosWorld, fPosEye and fNormal before this file
+//features, injected by gps::ShaderPermutations:
+//SHADOWS - cascades of the main light and the atlas of the point lights
+//SHADOW_EVSM - filtered moments instead of a hard depth comparison for the cascades
+//FOG - distance fog
+//NUM_POINT_LIGHTS - clustered lights shaded per fragment, 0 leaves them out
+
+#ifndef NUM_POINT_LIGHTS
+#define NUM_POINT_LIGHTS 128
+#endif
+
+#define SHADOW_CASCADE_COUNT 3
+#define MAX_SHADOW_TILES 32
+#define CLUSTER_COUNT_X 16
+#define CLUSTER_COUNT_Y 9
+#define CLUSTER_COUNT_Z 24
+
+//lighting
+uniform	vec3 mainLightDir;
+uniform	vec3 mainLightColor;
+
+//clustered point lights, 3 texels per light: position in eye coordinates and range, color and shadow tile, world position
+uniform samplerBuffer lightData;
+//offset and count of every cluster in lightIndices
+uniform usamplerBuffer clusterData;
+uniform usamplerBuffer lightIndices;
+//depth slice = log(viewDepth) * x + y
+uniform vec2 clusterSliceScaleBias;
+//size of a cluster on screen, in pixels
+uniform vec2 clusterTileSize;
+
+#ifdef SHADOWS
+//shadow cascades
+uniform sampler2DArray shadowMap;
+uniform mat4 cascadeLightSpaceTrMatrices[SHADOW_CASCADE_COUNT];
+uniform float cascadeSplits[SHADOW_CASCADE_COUNT];
+uniform float cascadeBiases[SHADOW_CASCADE_COUNT];
+
+//exponential variance shadow maps
+uniform sampler2DArray shadowMoments;
+uniform float evsmExponent;
+
+//shadow atlas of the local lights
+uniform sampler2DShadow shadowAtlas;
+uniform mat4 shadowTileMatrices[MAX_SHADOW_TILES];
+//xy - offset, zw - scale of the tile in the atlas
+uniform vec4 shadowTileRects[MAX_SHADOW_TILES];
+#endif
+
+//screen space derivatives of the world position, taken before any branching
+vec4 posWorldDx = vec4(0.0f);
+vec4 posWorldDy = vec4(0.0f);
+//material, sampled once and shared by all the lights
+vec3 diffuseColor = vec3(0.0f);
+vec3 specularColor = vec3(0.0f);
+
+struct LightStruct {
+	float ambientStrength;
+	float specularStrength;
+	float shininess;
+	vec3 lightColor;
+	vec3 lightDir;
+	//point lights only
+	float range;
+	//first of the 6 cube face tiles, -1 if the light has no shadow
+	int shadowTile;
+	vec3 lightPosWorld;
+} mainLight;
+
+#ifdef SHADOWS
+float computeAtlasShadow(int tile) {
+	vec4 fragPosLightSpace = shadowTileMatrices[tile] * fPosWorld;
+	vec3 normalizedCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
+	normalizedCoords = normalizedCoords * 0.5f + 0.5f;
+	if (normalizedCoords.z > 1.0f) {
+		return 0.0f;
+	}
+
+	//keep the filter footprint inside the tile
+	vec4 rect = shadowTileRects[tile];
+	vec2 halfTexel = 0.5f / vec2(textureSize(shadowAtlas, 0));
+	vec2 atlasCoords = clamp(rect.xy + normalizedCoords.xy * rect.zw, rect.xy + halfTexel, rect.xy + rect.zw - halfTexel);
+
+	const float bias = 0.0005f;
+	return 1.0f - texture(shadowAtlas, vec3(atlasCoords, normalizedCoords.z - bias));
+}
+
+float computePointShadow(LightStruct light) {
+	//the tiles follow the cube face order +x, -x, +y, -y, +z, -z
+	vec3 toFragment = fPosWorld.xyz - light.lightPosWorld;
+	vec3 absolute = abs(toFragment);
+	int face;
+	if (absolute.x >= absolute.y && absolute.x >= absolute.z) {
+		face = toFragment.x > 0.0f ? 0 : 1;
+	}
+	else if (absolute.y >= absolute.z) {
+		face = toFragment.y > 0.0f ? 2 : 3;
+	}
+	else {
+		face = toFragment.z > 0.0f ? 4 : 5;
+	}
+	return computeAtlasShadow(light.shadowTile + face);
+}
+
+float computeMomentsShadow(vec3 normalizedCoords, int cascade, vec2 coordsDx, vec2 coordsDy) {
+	//one trilinear fetch of the prefiltered moments replaces the PCF taps
+	vec2 moments = textureGrad(shadowMoments, vec3(normalizedCoords.xy, float(cascade)), coordsDx, coordsDy).rg;
+	float warpedDepth = exp(evsmExponent * (2.0f * normalizedCoords.z - 1.0f));
+	if (warpedDepth <= moments.x) {
+		return 0.0f;
+	}
+
+	//Chebyshev upper bound of the lit fraction
+	//minimum variance in depth units, scaled into the warped space
+	float warpSlope = evsmExponent * warpedDepth;
+	float minVariance = 0.00001f * warpSlope * warpSlope;
+	float variance = max(moments.y - moments.x * moments.x, minVariance);
+	float d = warpedDepth - moments.x;
+	float litFraction = variance / (variance + d * d);
+
+	//cut off the tail of the bound to reduce light bleeding
+	const float lightBleedReduction = 0.3f;
+	litFraction = clamp((litFraction - lightBleedReduction) / (1.0f - lightBleedReduction), 0.0f, 1.0f);
+	return 1.0f - litFraction;
+}
+
+float computeShadow() {
+	//pick the first cascade that contains the fragment
+	float viewDepth = -fPosEye.z;
+	int cascade = -1;
+	for (int i = SHADOW_CASCADE_COUNT - 1; i >= 0; i--) {
+		if (viewDepth < cascadeSplits[i]) {
+			cascade = i;
+		}
+	}
+	if (cascade < 0) {
+		return 0.0f;
+	}
+
+	vec4 fragPosLightSpace = cascadeLightSpaceTrMatrices[cascade] * fPosWorld;
+	vec3 normalizedCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
+	normalizedCoords = normalizedCoords * 0.5f + 0.5f;
+	if (normalizedCoords.z > 1.0f) {
+		return 0.0f;
+	}
+
+#ifdef SHADOW_EVSM
+	//ortho projection, so the derivatives transform linearly
+	vec2 coordsDx = 0.5f * (cascadeLightSpaceTrMatrices[cascade] * posWorldDx).xy;
+	vec2 coordsDy = 0.5f * (cascadeLightSpaceTrMatrices[cascade] * posWorldDy).xy;
+	return computeMomentsShadow(normalizedCoords, cascade, coordsDx, coordsDy);
+#else
+	float closestDepth = texture(shadowMap, vec3(normalizedCoords.xy, float(cascade))).r;
+	float currentDepth = normalizedCoords.z;
+	float shadow = currentDepth - cascadeBiases[cascade] > closestDepth ? 1.0f : 0.0f;
+	return shadow;
+#endif
+}
+#endif
+
+float computeFog() {
+	float fogDensity = 0.05f;
+	float fragmentDistance = length(fPosEye);
+	float fogFactor = exp(-pow(fragmentDistance * fogDensity, 2));
+	
+	return clamp(fogFactor, 0.0f, 1.0f);
+}
+
+vec4 applyFog(vec3 color, float alpha) {
+#ifdef FOG
+	vec4 fogColor = vec4(0.5f, 0.5f, 0.5f, 1.0f); //fog
+	return mix(fogColor, vec4(color, alpha), computeFog());
+#else
+	return vec4(color, alpha);
+#endif
+}
+
+//attenuation - 1 for the main light
+vec3 computeLightComponents(LightStruct light, float attenuation, float shadow)
+{		
+	vec3 cameraPosEye = vec3(0.0f);//in eye coordinates, the viewer is situated at the origin
+	
+	//transform normal
+	vec3 normalEye = normalize(fNormal);	
+	
+	//compute light direction
+	vec3 lightDirN = normalize(light.lightDir - fPosEye.xyz);
+	
+	//compute view direction 
+	vec3 viewDirN = normalize(cameraPosEye - fPosEye.xyz);
+		
+	//compute specular light
+	vec3 reflection = reflect(-lightDirN, normalEye);
+	float specCoeff = pow(max(dot(viewDirN, reflection), 0.0f), light.shininess);
+
+	vec3 ambient = attenuation * light.ambientStrength * light.lightColor;
+	vec3 diffuse = attenuation * max(dot(normalEye, lightDirN), 0.0f) * light.lightColor;
+	vec3 specular = attenuation * light.specularStrength * specCoeff * light.lightColor;
+	
+	ambient *= diffuseColor;
+	diffuse *= diffuseColor;
+	specular *= specularColor;
+
+	return min((ambient + (1.0f - shadow) * diffuse) + (1.0f - shadow) * specular, 1.0f);
+}
+
+vec3 computeMainLight()
+{
+	float shadow = 0.0f;
+#ifdef SHADOWS
+	shadow = computeShadow();
+#endif
+	return computeLightComponents(mainLight, 1.0f, shadow);
+}
+
+vec3 computePointLight(LightStruct light)
+{
+	float constant = 1.0f;
+	float linear = 0.0045f;
+	float quadratic = 0.0075f;
+	float dist = length(light.lightDir - fPosEye.xyz);
+	float att = 1.0f / (constant + linear * dist + quadratic * (dist * dist));
+	//fade to zero at the range so the light can be left out of the clusters it does not reach
+	float window = clamp(1.0f - pow(dist / light.range, 4.0f), 0.0f, 1.0f);
+	att *= window * window;
+
+	float shadow = 0.0f;
+#ifdef SHADOWS
+	if (light.shadowTile >= 0)
+		shadow = computePointShadow(light);
+#endif
+	return computeLightComponents(light, att, shadow);
+}
+
+vec3 computeClusteredLights()
+{
+#if NUM_POINT_LIGHTS == 0
+	return vec3(0.0f);
+#else
+	//cluster of the fragment
+	float viewDepth = -fPosEye.z;
+	int slice = int(log(viewDepth) * clusterSliceScaleBias.x + clusterSliceScaleBias.y);
+	ivec3 cluster = clamp(ivec3(ivec2(gl_FragCoord.xy / clusterTileSize), slice),
+		ivec3(0), ivec3(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1, CLUSTER_COUNT_Z - 1));
+	int clusterIndex = (cluster.z * CLUSTER_COUNT_Y + cluster.y) * CLUSTER_COUNT_X + cluster.x;
+	uvec2 offsetCount = texelFetch(clusterData, clusterIndex).rg;
+
+	vec3 color = vec3(0.0f);
+	uint count = min(offsetCount.y, uint(NUM_POINT_LIGHTS));
+	for (uint i = 0u; i < count; i++) {
+		int index = int(texelFetch(lightIndices, int(offsetCount.x + i)).r);
+		vec4 positionRange = texelFetch(lightData, 3 * index);
+		vec4 colorTile = texelFetch(lightData, 3 * index + 1);
+		vec3 positionWorld = texelFetch(lightData, 3 * index + 2).xyz;
+		LightStruct light = LightStruct(0.5f, 0.5f, 32.0f, colorTile.rgb, positionRange.xyz,
+			positionRange.w, int(colorTile.a), positionWorld);
+		color += computePointLight(light);
+	}
+	return color;
+#endif
+}
@@ -4,10 +4,11 @@ in vec2 fTexCoords;
 
 out vec4 fColor;
 
-uniform sampler2D depthMap;
+uniform sampler2DArray depthMap;
+uniform int depthMapLayer;
 
 void main() 
 {    
-    fColor = vec4(vec3(texture(depthMap, fTexCoords).r), 1.0f);
+    fColor = vec4(vec3(texture(depthMap, vec3(fTexCoords, float(depthMapLayer))).r), 1.0f);
     //fColor = vec4(fTexCoords, 0.0f, 1.0f);
 }
@@ -8,14 +8,14 @@ out vec3 fNormal;
 out vec4 fPosEye;
 out vec2 fTexCoords;
 
-out vec4 mainFragPosLightSpace;
+out vec4 fPosWorld;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 uniform	mat3 normalMatrix;
 
-uniform mat4 mainLightSpaceTrMatrix;
-uniform mat4 secondaryLightSpaceTrMatrix;
+//same depth as depthPrePass.vert, the main pass tests with GL_EQUAL after the pre-pass
+invariant gl_Position;
 
 void main() 
 {
@@ -24,7 +24,7 @@ void main()
 	fNormal = normalize(normalMatrix * vNormal);
 	fTexCoords = vTexCoords;
 
-    mainFragPosLightSpace = mainLightSpaceTrMatrix * model * vec4(vPosition, 1.0f);
+	fPosWorld = model * vec4(vPosition, 1.0f);
 	
 	gl_Position = projection * view * model * vec4(vPosition, 1.0f);
 }
@@ -0,0 +1,43 @@
+#version 410 core
+
+in vec2 fTexCoords;
+
+out vec2 fMoments;
+
+uniform sampler2DArray source;
+uniform int sourceLayer;
+//1 - source is a depth layer that is warped into moments, 0 - source already holds moments
+uniform int resolveDepth;
+uniform vec2 direction;
+uniform vec2 texelSize;
+uniform float exponent;
+
+//7 tap binomial kernel
+const float weights[4] = float[](20.0f / 64.0f, 15.0f / 64.0f, 6.0f / 64.0f, 1.0f / 64.0f);
+
+vec2 warpDepth(float depth)
+{
+	float warped = exp(exponent * (2.0f * depth - 1.0f));
+	return vec2(warped, warped * warped);
+}
+
+vec2 fetchMoments(vec2 coords)
+{
+	if (resolveDepth == 1) {
+		//the moments texel covers 2x2 depth texels, average their warped depths
+		vec4 depths = textureGather(source, vec3(coords, float(sourceLayer)), 0);
+		return 0.25f * (warpDepth(depths.x) + warpDepth(depths.y) + warpDepth(depths.z) + warpDepth(depths.w));
+	}
+	return texture(source, vec3(coords, float(sourceLayer))).rg;
+}
+
+void main()
+{
+	vec2 stepSize = direction * texelSize;
+	vec2 moments = weights[0] * fetchMoments(fTexCoords);
+	for (int i = 1; i < 4; i++) {
+		moments += weights[i] * fetchMoments(fTexCoords + float(i) * stepSize);
+		moments += weights[i] * fetchMoments(fTexCoords - float(i) * stepSize);
+	}
+	fMoments = moments;
+}
@@ -0,0 +1,126 @@
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace gps {
+
+    void Benchmark::Init(int frameCount, int warmupFrames) {
+        this->frameCount = frameCount;
+        this->warmupFrames = warmupFrames;
+        this->frame = 0;
+
+        //GL_TIME_ELAPSED cannot nest with the timers of the scene pass, timestamps can
+        glGenQueries(BENCHMARK_QUERY_RING, this->startQueries);
+        glGenQueries(BENCHMARK_QUERY_RING, this->endQueries);
+        for (int i = 0; i < BENCHMARK_QUERY_RING; i++) {
+            this->queryFrames[i] = -1;
+        }
+
+        this->cpuTimes.clear();
+        this->gpuTimes.assign(frameCount, 0.0);
+        this->drawCalls.clear();
+        this->triangles.clear();
+    }
+
+    void Benchmark::BeginFrame() {
+        int slot = this->frame % BENCHMARK_QUERY_RING;
+        //normally finished long ago, so this does not stall
+        this->readQuery(slot);
+
+        this->frameStart = std::chrono::steady_clock::now();
+        glQueryCounter(this->startQueries[slot], GL_TIMESTAMP);
+    }
+
+    void Benchmark::EndFrame(int drawCalls, int triangles) {
+        int slot = this->frame % BENCHMARK_QUERY_RING;
+        glQueryCounter(this->endQueries[slot], GL_TIMESTAMP);
+        this->queryFrames[slot] = this->frame;
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - this->frameStart;
+        if (this->frame >= this->warmupFrames) {
+            this->cpuTimes.push_back(elapsed.count());
+            this->drawCalls.push_back((double)drawCalls);
+            this->triangles.push_back((double)triangles);
+        }
+        this->frame++;
+    }
+
+    bool Benchmark::IsFinished() {
+        return this->frame >= this->warmupFrames + this->frameCount;
+    }
+
+    void Benchmark::Finish() {
+        for (int i = 0; i < BENCHMARK_QUERY_RING; i++) {
+            this->readQuery(i);
+        }
+    }
+
+    void Benchmark::readQuery(int slot) {
+        int queryFrame = this->queryFrames[slot];
+        if (queryFrame < 0) {
+            return;
+        }
+        this->queryFrames[slot] = -1;
+        if (queryFrame < this->warmupFrames) {
+            return;
+        }
+
+        GLuint64 start, end;
+        glGetQueryObjectui64v(this->startQueries[slot], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(this->endQueries[slot], GL_QUERY_RESULT, &end);
+        this->gpuTimes[queryFrame - this->warmupFrames] = (end - start) * 1e-6;
+    }
+
+    std::string Benchmark::statisticsJson(std::vector<double> values) {
+        if (values.empty()) {
+            return "null";
+        }
+
+        std::sort(values.begin(), values.end());
+        double sum = 0.0;
+        for (double value : values) {
+            sum += value;
+        }
+        //nearest rank
+        auto percentile = [&values](double p) {
+            size_t rank = (size_t)std::ceil(p / 100.0 * values.size());
+            return values[std::max(rank, (size_t)1) - 1];
+        };
+
+        std::ostringstream json;
+        json << "{ \"mean\": " << sum / values.size()
+            << ", \"p50\": " << percentile(50.0)
+            << ", \"p95\": " << percentile(95.0)
+            << ", \"p99\": " << percentile(99.0)
+            << ", \"min\": " << values.front()
+            << ", \"max\": " << values.back() << " }";
+        return json.str();
+    }
+
+    std::string Benchmark::getJson(std::string renderer, int width, int height) {
+        //frames that never got a GPU time, e.g. when stopped early
+        std::vector<double> measuredGpuTimes(this->gpuTimes.begin(),
+            this->gpuTimes.begin() + std::min((int)this->cpuTimes.size(), (int)this->gpuTimes.size()));
+
+        std::ostringstream json;
+        json << "{\n";
+        json << "  \"renderer\": \"" << renderer << "\",\n";
+        json << "  \"width\": " << width << ",\n";
+        json << "  \"height\": " << height << ",\n";
+        json << "  \"frames\": " << this->cpuTimes.size() << ",\n";
+        json << "  \"warmupFrames\": " << this->warmupFrames << ",\n";
+        json << "  \"cpuFrameMs\": " << statisticsJson(this->cpuTimes) << ",\n";
+        json << "  \"gpuFrameMs\": " << statisticsJson(measuredGpuTimes) << ",\n";
+        json << "  \"drawCalls\": " << statisticsJson(this->drawCalls) << ",\n";
+        json << "  \"triangles\": " << statisticsJson(this->triangles) << "\n";
+        json << "}\n";
+        return json.str();
+    }
+
+    void Benchmark::Delete() {
+        glDeleteQueries(BENCHMARK_QUERY_RING, this->startQueries);
+        glDeleteQueries(BENCHMARK_QUERY_RING, this->endQueries);
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef Benchmark_hpp
+#define Benchmark_hpp
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    //timestamp pairs in flight, a query is read back this many frames after it was issued
+    const int BENCHMARK_QUERY_RING = 4;
+
+    //per frame CPU and GPU times, draws and triangles, reported as percentiles
+    class Benchmark
+    {
+    public:
+        //warmupFrames are rendered before frameCount and left out of the statistics
+        void Init(int frameCount, int warmupFrames);
+        //call before the simulation of the frame, starts the CPU timer and the GPU timestamp
+        void BeginFrame();
+        //call once the frame is submitted
+        void EndFrame(int drawCalls, int triangles);
+        bool IsFinished();
+        //waits for the queries still in flight
+        void Finish();
+        std::string getJson(std::string renderer, int width, int height);
+        void Delete();
+
+    private:
+        int frameCount;
+        int warmupFrames;
+        int frame;
+        std::chrono::steady_clock::time_point frameStart;
+
+        GLuint startQueries[BENCHMARK_QUERY_RING];
+        GLuint endQueries[BENCHMARK_QUERY_RING];
+        //frame whose timestamps are in every slot, -1 if the slot is free
+        int queryFrames[BENCHMARK_QUERY_RING];
+
+        std::vector<double> cpuTimes;
+        std::vector<double> gpuTimes;
+        std::vector<double> drawCalls;
+        std::vector<double> triangles;
+
+        void readQuery(int slot);
+        static std::string statisticsJson(std::vector<double> values);
+    };
+
+}
+
+#endif /* Benchmark_hpp */
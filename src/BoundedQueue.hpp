@@ -0,0 +1,95 @@
+#ifndef BoundedQueue_hpp
+#define BoundedQueue_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace gps {
+
+    //fixed capacity multi producer, multi consumer queue without locks;
+    //every cell carries a sequence number telling whose turn it is, after Dmitry Vyukov's bounded queue
+    template <typename T>
+    class BoundedQueue
+    {
+    public:
+        //capacity is rounded up to a power of two
+        void Init(size_t capacity) {
+            size_t size = 2;
+            while (size < capacity) {
+                size *= 2;
+            }
+            this->cells = std::vector<Cell>(size);
+            this->mask = size - 1;
+            for (size_t i = 0; i < size; i++) {
+                this->cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            this->head.store(0, std::memory_order_relaxed);
+            this->tail.store(0, std::memory_order_relaxed);
+        }
+
+        //false if the queue is full
+        bool TryPush(const T& value) {
+            size_t position = this->tail.load(std::memory_order_relaxed);
+            for (;;) {
+                Cell& cell = this->cells[position & this->mask];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)position;
+                if (difference == 0) {
+                    if (this->tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        cell.value = value;
+                        cell.sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (difference < 0) {
+                    return false;
+                }
+                else {
+                    position = this->tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        //false if the queue is empty
+        bool TryPop(T& value) {
+            size_t position = this->head.load(std::memory_order_relaxed);
+            for (;;) {
+                Cell& cell = this->cells[position & this->mask];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)(position + 1);
+                if (difference == 0) {
+                    if (this->head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        value = cell.value;
+                        //the cell is free again one lap later
+                        cell.sequence.store(position + this->mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (difference < 0) {
+                    return false;
+                }
+                else {
+                    position = this->head.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T value;
+
+            Cell() : sequence(0), value() {}
+        };
+
+        std::vector<Cell> cells;
+        size_t mask;
+        //producers and consumers on separate cache lines
+        alignas(64) std::atomic<size_t> tail;
+        alignas(64) std::atomic<size_t> head;
+    };
+
+}
+
+#endif /* BoundedQueue_hpp */
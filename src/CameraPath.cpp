@@ -0,0 +1,94 @@
+#include "CameraPath.hpp"
+
+#include <cmath>
+
+namespace gps {
+
+    void CameraPath::Init(const std::vector<glm::vec3>& controlPoints) {
+        this->controlPoints = controlPoints;
+        this->looping = controlPoints.size() > 1 && glm::all(glm::equal(controlPoints.front(), controlPoints.back()));
+
+        //cumulative length of the polyline through the dense evaluations
+        int denseCount = (CAMERA_PATH_SAMPLES - 1) * CAMERA_PATH_OVERSAMPLING + 1;
+        std::vector<float> parameters(denseCount);
+        std::vector<float> distances(denseCount);
+        glm::vec3 previous = this->evaluateCurve(0.0f);
+        distances[0] = 0.0f;
+        for (int i = 1; i < denseCount; i++) {
+            parameters[i] = (float)i / (denseCount - 1);
+            glm::vec3 point = this->evaluateCurve(parameters[i]);
+            distances[i] = distances[i - 1] + glm::length(point - previous);
+            previous = point;
+        }
+        float length = distances[denseCount - 1];
+
+        //invert the distance function, the targets grow so the search only moves forward
+        this->samples.resize(CAMERA_PATH_SAMPLES);
+        int segment = 0;
+        for (int i = 0; i < CAMERA_PATH_SAMPLES; i++) {
+            float target = length * i / (CAMERA_PATH_SAMPLES - 1);
+            while (segment < denseCount - 2 && distances[segment + 1] < target) {
+                segment++;
+            }
+            float segmentLength = distances[segment + 1] - distances[segment];
+            float fraction = segmentLength > 0.0f ? glm::clamp((target - distances[segment]) / segmentLength, 0.0f, 1.0f) : 0.0f;
+            float t = glm::mix(parameters[segment], parameters[segment + 1], fraction);
+            this->samples[i] = this->evaluateCurve(t);
+        }
+    }
+
+    glm::vec3 CameraPath::evaluateCurve(float t) {
+        std::vector<glm::vec3> points = this->controlPoints;
+        for (size_t level = points.size() - 1; level > 0; level--) {
+            for (size_t i = 0; i < level; i++) {
+                points[i] = glm::mix(points[i], points[i + 1], t);
+            }
+        }
+        return points[0];
+    }
+
+    glm::vec3 CameraPath::getSample(int index) {
+        int last = CAMERA_PATH_SAMPLES - 1;
+        if (this->looping) {
+            //the last sample is the first one again
+            index %= last;
+            if (index < 0) {
+                index += last;
+            }
+            return this->samples[index];
+        }
+        return this->samples[glm::clamp(index, 0, last)];
+    }
+
+    glm::vec3 CameraPath::getPosition(float distance) {
+        if (this->looping) {
+            distance -= std::floor(distance);
+        }
+        else {
+            distance = glm::clamp(distance, 0.0f, 1.0f);
+        }
+
+        float position = distance * (CAMERA_PATH_SAMPLES - 1);
+        int index = glm::min((int)position, CAMERA_PATH_SAMPLES - 2);
+        float f = position - index;
+
+        //Catmull-Rom through the neighbouring samples, the velocity stays continuous between segments
+        glm::vec3 p0 = this->getSample(index - 1);
+        glm::vec3 p1 = this->getSample(index);
+        glm::vec3 p2 = this->getSample(index + 1);
+        glm::vec3 p3 = this->getSample(index + 2);
+        float f2 = f * f;
+        float f3 = f2 * f;
+        return 0.5f * ((2.0f * p1) + (p2 - p0) * f + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * f2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * f3);
+    }
+
+    std::vector<glm::vec3> CameraPath::SamplePositions(int count) {
+        std::vector<glm::vec3> positions(count);
+        //a loop would repeat its first position at the end
+        int steps = this->looping ? count : count - 1;
+        for (int i = 0; i < count; i++) {
+            positions[i] = this->getPosition(steps > 0 ? (float)i / steps : 0.0f);
+        }
+        return positions;
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef CameraPath_hpp
+#define CameraPath_hpp
+
+#include "glm/glm.hpp"
+
+#include <vector>
+
+namespace gps {
+
+    //points of the lookup table, spaced equally along the curve
+    const int CAMERA_PATH_SAMPLES = 1024;
+    //curve evaluations per table point when the length is measured
+    const int CAMERA_PATH_OVERSAMPLING = 8;
+
+    //Bezier camera path reparameterized by arc length, so a constant step moves the camera at a constant speed;
+    //the curve is evaluated only when the table is built, a position costs one cubic segment
+    class CameraPath
+    {
+    public:
+        //the control points of a single Bezier curve; if the last equals the first the path loops
+        void Init(const std::vector<glm::vec3>& controlPoints);
+        //distance - fraction of the length of the path, wraps around on a looping path and is clamped otherwise
+        glm::vec3 getPosition(float distance);
+        //count positions spaced equally along the whole path, for offline renders
+        std::vector<glm::vec3> SamplePositions(int count);
+
+    private:
+        std::vector<glm::vec3> controlPoints;
+        //CAMERA_PATH_SAMPLES points, the first and the last at the ends of the curve
+        std::vector<glm::vec3> samples;
+        bool looping = false;
+
+        //de Casteljau, stable for the high degree of the path
+        glm::vec3 evaluateCurve(float t);
+        glm::vec3 getSample(int index);
+    };
+
+}
+
+#endif /* CameraPath_hpp */
@@ -0,0 +1,94 @@
+#include "CameraRecording.hpp"
+#include "Logger.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+namespace gps {
+
+    static const char CAMERA_RECORDING_MAGIC[4] = { 'G', 'P', 'S', 'C' };
+    static const uint32_t CAMERA_RECORDING_VERSION = 1;
+
+    bool CameraRecording::BeginRecording(std::string path, int stepsPerSecond) {
+        this->file.open(path, std::ios::binary | std::ios::trunc);
+        if (!this->file) {
+            GPS_LOG_ERROR("Could not create the camera recording %s", path.c_str());
+            return false;
+        }
+        uint32_t rate = (uint32_t)stepsPerSecond;
+        this->file.write(CAMERA_RECORDING_MAGIC, sizeof(CAMERA_RECORDING_MAGIC));
+        this->file.write((const char*)&CAMERA_RECORDING_VERSION, sizeof(CAMERA_RECORDING_VERSION));
+        this->file.write((const char*)&rate, sizeof(rate));
+        this->recording = true;
+        this->recordedSamples = 0;
+        return true;
+    }
+
+    void CameraRecording::Record(const CameraSample& sample) {
+        if (!this->recording) {
+            return;
+        }
+        //field by field, the struct has padding
+        float values[5] = { sample.position.x, sample.position.y, sample.position.z, sample.yaw, sample.pitch };
+        uint8_t animated = sample.animated ? 1 : 0;
+        this->file.write((const char*)values, sizeof(values));
+        this->file.write((const char*)&animated, sizeof(animated));
+        this->recordedSamples++;
+    }
+
+    void CameraRecording::EndRecording() {
+        if (!this->recording) {
+            return;
+        }
+        this->file.close();
+        this->recording = false;
+        GPS_LOG_INFO("Recorded %d camera steps", this->recordedSamples);
+    }
+
+    bool CameraRecording::isRecording() {
+        return this->recording;
+    }
+
+    bool CameraRecording::Load(std::string path) {
+        std::ifstream input(path, std::ios::binary);
+        char magic[4];
+        uint32_t version = 0;
+        uint32_t rate = 0;
+        if (!input.read(magic, sizeof(magic)) || std::memcmp(magic, CAMERA_RECORDING_MAGIC, sizeof(magic)) != 0 ||
+            !input.read((char*)&version, sizeof(version)) || version != CAMERA_RECORDING_VERSION ||
+            !input.read((char*)&rate, sizeof(rate))) {
+            GPS_LOG_ERROR("Not a camera recording: %s", path.c_str());
+            return false;
+        }
+        this->stepsPerSecond = (int)rate;
+
+        this->samples.clear();
+        float values[5];
+        uint8_t animated;
+        while (input.read((char*)values, sizeof(values)) && input.read((char*)&animated, sizeof(animated))) {
+            CameraSample sample;
+            sample.position = glm::vec3(values[0], values[1], values[2]);
+            sample.yaw = values[3];
+            sample.pitch = values[4];
+            sample.animated = animated != 0;
+            this->samples.push_back(sample);
+        }
+        return true;
+    }
+
+    bool CameraRecording::getSample(int step, CameraSample& sample) {
+        if (step < 0 || step >= (int)this->samples.size()) {
+            return false;
+        }
+        sample = this->samples[step];
+        return true;
+    }
+
+    int CameraRecording::getSampleCount() {
+        return (int)this->samples.size();
+    }
+
+    int CameraRecording::getStepsPerSecond() {
+        return this->stepsPerSecond;
+    }
+}
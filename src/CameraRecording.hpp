@@ -0,0 +1,49 @@
+#ifndef CameraRecording_hpp
+#define CameraRecording_hpp
+
+#include "glm/glm.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    //state of the camera after one simulation step
+    struct CameraSample {
+        glm::vec3 position;
+        float yaw;
+        float pitch;
+        //the camera followed the animation path, looking at its target instead of along yaw and pitch
+        bool animated;
+    };
+
+    //camera of every simulation step in a small binary file, so a session can be replayed exactly;
+    //a header with the step rate, then 21 bytes per step
+    class CameraRecording
+    {
+    public:
+        //start a new file, false if it cannot be created
+        bool BeginRecording(std::string path, int stepsPerSecond);
+        void Record(const CameraSample& sample);
+        void EndRecording();
+        bool isRecording();
+
+        //read a whole file, false if it is missing or not a recording
+        bool Load(std::string path);
+        //the sample of a step, false past the last one
+        bool getSample(int step, CameraSample& sample);
+        int getSampleCount();
+        int getStepsPerSecond();
+
+    private:
+        std::ofstream file;
+        bool recording = false;
+        int recordedSamples = 0;
+        std::vector<CameraSample> samples;
+        int stepsPerSecond = 0;
+    };
+
+}
+
+#endif /* CameraRecording_hpp */
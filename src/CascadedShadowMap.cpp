@@ -0,0 +1,307 @@
+#include "CascadedShadowMap.hpp"
+#include "GLStateCache.hpp"
+
+#include <cmath>
+
+namespace gps {
+
+    //blend between the logarithmic (1.0) and the uniform (0.0) split scheme
+    const float CASCADE_SPLIT_LAMBDA = 0.8f;
+    //depth bias expressed in shadow map texels
+    const float CASCADE_BIAS_TEXELS = 1.5f;
+
+    void CascadedShadowMap::Init(unsigned int resolution, int cascadeCount) {
+        this->resolution = resolution;
+        this->cascadeCount = glm::clamp(cascadeCount, 1, MAX_SHADOW_CASCADES);
+        this->cascades.resize(this->cascadeCount);
+        this->lightView = glm::mat4(1.0f);
+        this->InvalidateStaticCache();
+
+        this->depthTexture = this->createDepthArray();
+        this->staticDepthTexture = this->createDepthArray();
+
+        glGenFramebuffers(1, &this->framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, this->depthTexture, 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+
+        glGenFramebuffers(1, &this->staticFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, this->staticFramebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, this->staticDepthTexture, 0, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+
+        this->momentsResolution = glm::max(resolution / 2, 1u);
+        this->momentsTexture = this->createMomentsArray(this->cascadeCount, true);
+        this->momentsBlurTexture = this->createMomentsArray(1, false);
+
+        glGenFramebuffers(1, &this->momentsFramebuffer);
+        glGenVertexArrays(1, &this->fullScreenVAO);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    GLuint CascadedShadowMap::createMomentsArray(int layers, bool mipmapped) {
+        //two 32 bit channels are needed to store exp(c * depth) and its square without overflowing
+        int levels = 1;
+        if (mipmapped) {
+            while ((this->momentsResolution >> levels) > 0) {
+                levels++;
+            }
+        }
+
+        GLuint texture;
+        glGenTextures(1, &texture);
+        GLStateCache::get().BindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+        for (int level = 0; level < levels; level++) {
+            GLsizei size = glm::max(this->momentsResolution >> level, 1u);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RG32F, size, size, layers, 0, GL_RG, GL_FLOAT, NULL);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    GLuint CascadedShadowMap::createDepthArray() {
+        //one depth layer per cascade
+        GLuint texture;
+        glGenTextures(1, &texture);
+        GLStateCache::get().BindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F,
+            this->resolution, this->resolution, this->cascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return texture;
+    }
+
+    void CascadedShadowMap::Update(glm::mat4 cameraView, float fovY, float aspect, float nearPlane, float shadowDistance,
+        glm::vec3 lightDir, BoundingBox sceneBounds) {
+        //the light view only depends on the light direction, so the texel grid stays fixed while the camera moves
+        this->lightView = glm::lookAt(glm::normalize(lightDir), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        BoundingBox sceneLightSpace = transformBoundingBox(sceneBounds, this->lightView);
+
+        glm::mat4 inverseCameraView = glm::inverse(cameraView);
+        float tanHalfFovY = std::tan(fovY * 0.5f);
+        float tanHalfFovX = tanHalfFovY * aspect;
+
+        float sliceNear = nearPlane;
+        for (int i = 0; i < this->cascadeCount; i++) {
+            float p = (float)(i + 1) / (float)this->cascadeCount;
+            float logSplit = nearPlane * std::pow(shadowDistance / nearPlane, p);
+            float uniformSplit = nearPlane + (shadowDistance - nearPlane) * p;
+            float sliceFar = CASCADE_SPLIT_LAMBDA * logSplit + (1.0f - CASCADE_SPLIT_LAMBDA) * uniformSplit;
+
+            //corners of the frustum slice, in world coordinates
+            glm::vec3 corners[8];
+            glm::vec3 center(0.0f);
+            for (int c = 0; c < 8; c++) {
+                float distance = (c & 4) ? sliceFar : sliceNear;
+                glm::vec4 cornerEye(
+                    ((c & 1) ? 1.0f : -1.0f) * tanHalfFovX * distance,
+                    ((c & 2) ? 1.0f : -1.0f) * tanHalfFovY * distance,
+                    -distance,
+                    1.0f);
+                corners[c] = glm::vec3(inverseCameraView * cornerEye);
+                center += corners[c] / 8.0f;
+            }
+
+            //a bounding sphere keeps the projection size constant when the camera rotates
+            float radius = 0.0f;
+            for (int c = 0; c < 8; c++) {
+                radius = glm::max(radius, glm::length(corners[c] - center));
+            }
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+
+            //snap the center to whole texels to stop the shadow edges from shimmering
+            glm::vec3 centerLightSpace = glm::vec3(this->lightView * glm::vec4(center, 1.0f));
+            float texelSize = 2.0f * radius / (float)this->resolution;
+            centerLightSpace.x = std::floor(centerLightSpace.x / texelSize) * texelSize;
+            centerLightSpace.y = std::floor(centerLightSpace.y / texelSize) * texelSize;
+            centerLightSpace.z = std::floor(centerLightSpace.z / texelSize) * texelSize;
+
+            Cascade& cascade = this->cascades[i];
+            cascade.boundsMin = centerLightSpace - glm::vec3(radius);
+            cascade.boundsMax = centerLightSpace + glm::vec3(radius);
+            //the depth range spans the whole scene, so casters between the light and the slice are still rendered
+            //and the range does not change while the camera moves, which keeps the static cache valid
+            cascade.boundsMin.z = std::floor(sceneLightSpace.min.z) - 1.0f;
+            cascade.boundsMax.z = std::ceil(sceneLightSpace.max.z) + 1.0f;
+
+            cascade.lightProjection = glm::ortho(
+                cascade.boundsMin.x, cascade.boundsMax.x,
+                cascade.boundsMin.y, cascade.boundsMax.y,
+                -cascade.boundsMax.z, -cascade.boundsMin.z);
+            cascade.splitDistance = sliceFar;
+            cascade.depthBias = CASCADE_BIAS_TEXELS * texelSize / (cascade.boundsMax.z - cascade.boundsMin.z);
+
+            //the receivers are the part of the scene inside the sphere of the slice, the sphere is used
+            //instead of the slice itself so the region does not change while the camera rotates
+            cascade.receivers.min = glm::max(centerLightSpace - glm::vec3(radius), sceneLightSpace.min);
+            cascade.receivers.max = glm::min(centerLightSpace + glm::vec3(radius), sceneLightSpace.max);
+
+            //the snapped projection only changes when the light turns or the slice moves by a whole texel
+            if (cascade.staticLightSpaceTrMatrix != this->getLightSpaceTrMatrix(i) ||
+                cascade.staticReceivers.min != cascade.receivers.min ||
+                cascade.staticReceivers.max != cascade.receivers.max) {
+                cascade.staticValid = false;
+            }
+
+            sliceNear = sliceFar;
+        }
+    }
+
+    bool CascadedShadowMap::NeedsStaticUpdate(int cascade) {
+        return !this->cascades[cascade].staticValid;
+    }
+
+    void CascadedShadowMap::BindStaticCascade(int cascade) {
+        glBindFramebuffer(GL_FRAMEBUFFER, this->staticFramebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, this->staticDepthTexture, 0, cascade);
+        glViewport(0, 0, this->resolution, this->resolution);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        this->cascades[cascade].staticLightSpaceTrMatrix = this->getLightSpaceTrMatrix(cascade);
+        this->cascades[cascade].staticReceivers = this->cascades[cascade].receivers;
+        this->cascades[cascade].staticValid = true;
+    }
+
+    void CascadedShadowMap::BindDynamicCascade(int cascade) {
+        this->cascades[cascade].momentsValid = false;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, this->staticFramebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, this->staticDepthTexture, 0, cascade);
+        glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, this->depthTexture, 0, cascade);
+
+        //a depth blit is much cheaper than drawing the static casters again
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, this->staticFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, this->framebuffer);
+        glBlitFramebuffer(0, 0, this->resolution, this->resolution, 0, 0, this->resolution, this->resolution,
+            GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+        glViewport(0, 0, this->resolution, this->resolution);
+    }
+
+    void CascadedShadowMap::InvalidateStaticCache() {
+        for (size_t i = 0; i < this->cascades.size(); i++) {
+            this->cascades[i].staticValid = false;
+            this->cascades[i].momentsValid = false;
+        }
+    }
+
+    void CascadedShadowMap::UpdateMoments(gps::Shader& momentsShader) {
+        bool updated = false;
+
+        momentsShader.useShaderProgram();
+        glUniform1i(momentsShader.getUniformLocation("source"), 0);
+        glUniform1f(momentsShader.getUniformLocation("exponent"), EVSM_EXPONENT);
+        glUniform2f(momentsShader.getUniformLocation("texelSize"),
+            1.0f / (float)this->momentsResolution, 1.0f / (float)this->momentsResolution);
+        GLint directionLoc = momentsShader.getUniformLocation("direction");
+        GLint sourceLayerLoc = momentsShader.getUniformLocation("sourceLayer");
+        GLint resolveDepthLoc = momentsShader.getUniformLocation("resolveDepth");
+
+        glBindFramebuffer(GL_FRAMEBUFFER, this->momentsFramebuffer);
+        glViewport(0, 0, this->momentsResolution, this->momentsResolution);
+        GLStateCache& state = GLStateCache::get();
+        state.SetEnabled(GL_DEPTH_TEST, false);
+        state.BindVertexArray(this->fullScreenVAO);
+
+        for (int i = 0; i < this->cascadeCount; i++) {
+            if (this->cascades[i].momentsValid)
+                continue;
+
+            //horizontal pass, warps 2x2 depth texels into one moments texel
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, this->momentsBlurTexture, 0, 0);
+            state.BindTexture(0, GL_TEXTURE_2D_ARRAY, this->depthTexture);
+            glUniform2f(directionLoc, 1.0f, 0.0f);
+            glUniform1i(sourceLayerLoc, i);
+            glUniform1i(resolveDepthLoc, 1);
+            state.DrawArrays(GL_TRIANGLES, 0, 3);
+
+            //vertical pass into the layer of the cascade
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, this->momentsTexture, 0, i);
+            state.BindTexture(0, GL_TEXTURE_2D_ARRAY, this->momentsBlurTexture);
+            glUniform2f(directionLoc, 0.0f, 1.0f);
+            glUniform1i(sourceLayerLoc, 0);
+            glUniform1i(resolveDepthLoc, 0);
+            state.DrawArrays(GL_TRIANGLES, 0, 3);
+
+            this->cascades[i].momentsValid = true;
+            updated = true;
+        }
+
+        state.SetEnabled(GL_DEPTH_TEST, true);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        //prefiltered mips let the lighting pass soften the shadows with a single trilinear fetch
+        if (updated) {
+            state.BindTexture(0, GL_TEXTURE_2D_ARRAY, this->momentsTexture);
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        }
+    }
+
+    bool CascadedShadowMap::IsCasterVisible(int cascade, BoundingBox worldBounds) {
+        BoundingBox lightSpaceBounds = transformBoundingBox(worldBounds, this->lightView);
+        const BoundingBox& receivers = this->cascades[cascade].receivers;
+
+        //the receivers are extruded towards the light (+z in light space), so a caster only has to
+        //overlap them in x and y and must not lie entirely behind them
+        return lightSpaceBounds.max.x >= receivers.min.x && lightSpaceBounds.min.x <= receivers.max.x &&
+            lightSpaceBounds.max.y >= receivers.min.y && lightSpaceBounds.min.y <= receivers.max.y &&
+            lightSpaceBounds.max.z >= receivers.min.z;
+    }
+
+    void CascadedShadowMap::Delete() {
+        GLStateCache::get().ForgetTexture(this->depthTexture);
+        glDeleteTextures(1, &this->depthTexture);
+        GLStateCache::get().ForgetTexture(this->staticDepthTexture);
+        glDeleteTextures(1, &this->staticDepthTexture);
+        glDeleteFramebuffers(1, &this->framebuffer);
+        glDeleteFramebuffers(1, &this->staticFramebuffer);
+        GLStateCache::get().ForgetTexture(this->momentsTexture);
+        glDeleteTextures(1, &this->momentsTexture);
+        GLStateCache::get().ForgetTexture(this->momentsBlurTexture);
+        glDeleteTextures(1, &this->momentsBlurTexture);
+        glDeleteFramebuffers(1, &this->momentsFramebuffer);
+        glDeleteVertexArrays(1, &this->fullScreenVAO);
+    }
+
+    glm::mat4 CascadedShadowMap::getLightSpaceTrMatrix(int cascade) {
+        return this->cascades[cascade].lightProjection * this->lightView;
+    }
+
+    float CascadedShadowMap::getSplitDistance(int cascade) {
+        return this->cascades[cascade].splitDistance;
+    }
+
+    float CascadedShadowMap::getDepthBias(int cascade) {
+        return this->cascades[cascade].depthBias;
+    }
+
+    int CascadedShadowMap::getCascadeCount() {
+        return this->cascadeCount;
+    }
+
+    unsigned int CascadedShadowMap::getResolution() {
+        return this->resolution;
+    }
+
+    GLuint CascadedShadowMap::getDepthTexture() {
+        return this->depthTexture;
+    }
+
+    GLuint CascadedShadowMap::getMomentsTexture() {
+        return this->momentsTexture;
+    }
+}
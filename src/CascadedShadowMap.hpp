@@ -0,0 +1,97 @@
+#ifndef CascadedShadowMap_hpp
+#define CascadedShadowMap_hpp
+
+#include <GL/glew.h>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "Mesh.hpp"
+#include "Shader.hpp"
+
+#include <vector>
+
+namespace gps {
+
+    const int MAX_SHADOW_CASCADES = 4;
+    //exponent used to warp the depth before the moments are stored (EVSM)
+    const float EVSM_EXPONENT = 40.0f;
+
+    class CascadedShadowMap
+    {
+    public:
+        //create the depth texture array and the framebuffer used to render the cascades
+        void Init(unsigned int resolution, int cascadeCount);
+        //split the camera frustum and fit one light projection around each slice
+        //lightDir - direction towards the light, in world coordinates
+        //sceneBounds - world bounds of all the casters and receivers
+        void Update(glm::mat4 cameraView, float fovY, float aspect, float nearPlane, float shadowDistance,
+            glm::vec3 lightDir, BoundingBox sceneBounds);
+        //true if the cached static casters of the cascade are out of date
+        bool NeedsStaticUpdate(int cascade);
+        //bind the static cache layer of the cascade and clear it, the static casters are drawn next
+        void BindStaticCascade(int cascade);
+        //copy the static cache into the cascade and bind it, the dynamic casters are drawn on top
+        void BindDynamicCascade(int cascade);
+        //force the static casters of every cascade to be rendered again
+        void InvalidateStaticCache();
+        //compute the blurred exponential moments of every cascade whose depth changed since the last call
+        //and regenerate their mipmaps, the moments of the other cascades are reused
+        void UpdateMoments(gps::Shader& momentsShader);
+        //true if a caster with the given world bounds can cast a shadow onto a receiver of the cascade
+        bool IsCasterVisible(int cascade, BoundingBox worldBounds);
+        void Delete();
+
+        glm::mat4 getLightSpaceTrMatrix(int cascade);
+        //view space distance where the cascade ends
+        float getSplitDistance(int cascade);
+        //constant depth bias of the cascade, scaled to its depth range
+        float getDepthBias(int cascade);
+        int getCascadeCount();
+        unsigned int getResolution();
+        GLuint getDepthTexture();
+        //prefiltered moments, half the resolution of the depth layers
+        GLuint getMomentsTexture();
+
+    private:
+        struct Cascade {
+            glm::mat4 lightProjection;
+            //light space extents of the orthographic projection
+            glm::vec3 boundsMin;
+            glm::vec3 boundsMax;
+            float splitDistance;
+            float depthBias;
+            //light space region that can receive shadows from the cascade
+            BoundingBox receivers;
+            //light space matrix and receivers the static cache layer was rendered with
+            glm::mat4 staticLightSpaceTrMatrix;
+            BoundingBox staticReceivers;
+            bool staticValid;
+            //the moments layer matches the depth layer
+            bool momentsValid;
+        };
+
+        GLuint framebuffer;
+        GLuint depthTexture;
+        //static casters only, copied into depthTexture before the dynamic casters are drawn
+        GLuint staticFramebuffer;
+        GLuint staticDepthTexture;
+        //moments are resolved from the depth layers with a separable blur through momentsBlurTexture
+        GLuint momentsFramebuffer;
+        GLuint momentsTexture;
+        GLuint momentsBlurTexture;
+        unsigned int momentsResolution;
+        //empty vertex array for the full screen triangle of the blur passes
+        GLuint fullScreenVAO;
+        unsigned int resolution;
+        int cascadeCount;
+        glm::mat4 lightView;
+        std::vector<Cascade> cascades;
+
+        GLuint createDepthArray();
+        GLuint createMomentsArray(int layers, bool mipmapped);
+    };
+
+}
+
+#endif /* CascadedShadowMap_hpp */
@@ -0,0 +1,188 @@
+#include "ClusteredLights.hpp"
+#include "GLStateCache.hpp"
+
+#include <cmath>
+
+namespace gps {
+
+    const int CLUSTER_COUNT = CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z;
+
+    void ClusteredLights::Init() {
+        //GL 4.1 has no storage buffers, texture buffers are read with texelFetch instead
+        this->createTextureBuffer(this->lightBuffer, this->lightTexture, GL_RGBA32F);
+        this->createTextureBuffer(this->clusterBuffer, this->clusterTexture, GL_RG32UI);
+        this->createTextureBuffer(this->indexBuffer, this->indexTexture, GL_R32UI);
+        this->lightCount = 0;
+        this->lightIndexCount = 0;
+    }
+
+    void ClusteredLights::createTextureBuffer(GLuint& buffer, GLuint& texture, GLenum format) {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+
+        glGenTextures(1, &texture);
+        GLStateCache::get().BindTexture(0, GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    int ClusteredLights::computeSlice(float depth) {
+        //exponential slices keep the froxels roughly cubic
+        if (depth <= this->nearPlane) {
+            return 0;
+        }
+        int slice = (int)(std::log(depth / this->nearPlane) / std::log(this->farPlane / this->nearPlane) * CLUSTER_COUNT_Z);
+        return glm::clamp(slice, 0, CLUSTER_COUNT_Z - 1);
+    }
+
+    void ClusteredLights::Update(std::vector<PointLight> lights, glm::mat4 view, float fovY, float aspect, float nearPlane, float farPlane) {
+        this->nearPlane = nearPlane;
+        this->farPlane = farPlane;
+        this->lightCount = (int)lights.size();
+
+        float scaleY = 1.0f / std::tan(fovY * 0.5f);
+        float scaleX = scaleY / aspect;
+
+        //cluster range covered by every light
+        std::vector<glm::ivec3> rangeMin(lights.size());
+        std::vector<glm::ivec3> rangeMax(lights.size());
+        std::vector<GLuint> counts(CLUSTER_COUNT, 0);
+
+        this->lightData.resize(lights.size() * 3);
+        for (size_t i = 0; i < lights.size(); i++) {
+            glm::vec3 center = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+            float radius = lights[i].range;
+            this->lightData[3 * i] = glm::vec4(center, radius);
+            this->lightData[3 * i + 1] = glm::vec4(lights[i].color, (float)lights[i].shadowTile);
+            //the shadow cube faces are picked in world space
+            this->lightData[3 * i + 2] = glm::vec4(lights[i].position, 1.0f);
+
+            float nearDepth = -(center.z + radius);
+            float farDepth = -(center.z - radius);
+            if (farDepth < nearPlane || nearDepth > farPlane) {
+                //behind the camera or past the far plane
+                rangeMin[i] = glm::ivec3(0);
+                rangeMax[i] = glm::ivec3(-1);
+                continue;
+            }
+
+            glm::ivec2 tileMin(0);
+            glm::ivec2 tileMax(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1);
+            if (nearDepth > nearPlane) {
+                //screen rectangle of the box around the sphere, the sides are widest at the nearest depth
+                glm::vec2 ndcMin(1.0f);
+                glm::vec2 ndcMax(-1.0f);
+                float depths[2] = { nearDepth, farDepth };
+                for (int d = 0; d < 2; d++) {
+                    for (int corner = 0; corner < 4; corner++) {
+                        float x = center.x + ((corner & 1) ? radius : -radius);
+                        float y = center.y + ((corner & 2) ? radius : -radius);
+                        glm::vec2 ndc(x * scaleX / depths[d], y * scaleY / depths[d]);
+                        ndcMin = glm::min(ndcMin, ndc);
+                        ndcMax = glm::max(ndcMax, ndc);
+                    }
+                }
+                ndcMin = glm::clamp(ndcMin, glm::vec2(-1.0f), glm::vec2(1.0f));
+                ndcMax = glm::clamp(ndcMax, glm::vec2(-1.0f), glm::vec2(1.0f));
+                if (ndcMin.x >= ndcMax.x || ndcMin.y >= ndcMax.y) {
+                    rangeMin[i] = glm::ivec3(0);
+                    rangeMax[i] = glm::ivec3(-1);
+                    continue;
+                }
+                tileMin = glm::ivec2((ndcMin * 0.5f + 0.5f) * glm::vec2(CLUSTER_COUNT_X, CLUSTER_COUNT_Y));
+                tileMax = glm::ivec2((ndcMax * 0.5f + 0.5f) * glm::vec2(CLUSTER_COUNT_X, CLUSTER_COUNT_Y));
+                tileMax = glm::min(tileMax, glm::ivec2(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1));
+            }
+
+            rangeMin[i] = glm::ivec3(tileMin, this->computeSlice(nearDepth));
+            rangeMax[i] = glm::ivec3(tileMax, this->computeSlice(farDepth));
+
+            for (int z = rangeMin[i].z; z <= rangeMax[i].z; z++)
+                for (int y = rangeMin[i].y; y <= rangeMax[i].y; y++)
+                    for (int x = rangeMin[i].x; x <= rangeMax[i].x; x++) {
+                        GLuint& count = counts[(z * CLUSTER_COUNT_Y + y) * CLUSTER_COUNT_X + x];
+                        if (count < (GLuint)MAX_LIGHTS_PER_CLUSTER) {
+                            count++;
+                        }
+                    }
+        }
+
+        //prefix sum of the counts gives the offset of every cluster list
+        this->clusterData.resize(CLUSTER_COUNT * 2);
+        GLuint offset = 0;
+        for (int c = 0; c < CLUSTER_COUNT; c++) {
+            this->clusterData[2 * c] = offset;
+            this->clusterData[2 * c + 1] = 0;
+            offset += counts[c];
+        }
+        this->lightIndexCount = (int)offset;
+
+        this->lightIndices.resize(glm::max(offset, 1u));
+        for (size_t i = 0; i < lights.size(); i++) {
+            for (int z = rangeMin[i].z; z <= rangeMax[i].z; z++)
+                for (int y = rangeMin[i].y; y <= rangeMax[i].y; y++)
+                    for (int x = rangeMin[i].x; x <= rangeMax[i].x; x++) {
+                        int c = (z * CLUSTER_COUNT_Y + y) * CLUSTER_COUNT_X + x;
+                        if (this->clusterData[2 * c + 1] < counts[c]) {
+                            this->lightIndices[this->clusterData[2 * c] + this->clusterData[2 * c + 1]] = (GLuint)i;
+                            this->clusterData[2 * c + 1]++;
+                        }
+                    }
+        }
+
+        if (this->lightData.empty()) {
+            this->lightData.push_back(glm::vec4(0.0f));
+        }
+
+        //orphan the buffers so the upload does not wait for the previous frame
+        glBindBuffer(GL_TEXTURE_BUFFER, this->lightBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, this->lightData.size() * sizeof(glm::vec4), &this->lightData[0], GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, this->clusterBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, this->clusterData.size() * sizeof(GLuint), &this->clusterData[0], GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, this->indexBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, this->lightIndices.size() * sizeof(GLuint), &this->lightIndices[0], GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void ClusteredLights::Bind(gps::Shader& shader, int firstUnit, int viewportWidth, int viewportHeight) {
+        shader.useShaderProgram();
+
+        GLStateCache& state = GLStateCache::get();
+        state.BindTexture(firstUnit, GL_TEXTURE_BUFFER, this->lightTexture);
+        glUniform1i(shader.getUniformLocation("lightData"), firstUnit);
+        state.BindTexture(firstUnit + 1, GL_TEXTURE_BUFFER, this->clusterTexture);
+        glUniform1i(shader.getUniformLocation("clusterData"), firstUnit + 1);
+        state.BindTexture(firstUnit + 2, GL_TEXTURE_BUFFER, this->indexTexture);
+        glUniform1i(shader.getUniformLocation("lightIndices"), firstUnit + 2);
+
+        //slice = log(depth) * scale + bias
+        float logDepthRange = std::log(this->farPlane / this->nearPlane);
+        glUniform2f(shader.getUniformLocation("clusterSliceScaleBias"),
+            CLUSTER_COUNT_Z / logDepthRange,
+            -CLUSTER_COUNT_Z * std::log(this->nearPlane) / logDepthRange);
+        glUniform2f(shader.getUniformLocation("clusterTileSize"),
+            (float)viewportWidth / CLUSTER_COUNT_X, (float)viewportHeight / CLUSTER_COUNT_Y);
+    }
+
+    void ClusteredLights::Delete() {
+        GLStateCache::get().ForgetTexture(this->lightTexture);
+        glDeleteTextures(1, &this->lightTexture);
+        GLStateCache::get().ForgetTexture(this->clusterTexture);
+        glDeleteTextures(1, &this->clusterTexture);
+        GLStateCache::get().ForgetTexture(this->indexTexture);
+        glDeleteTextures(1, &this->indexTexture);
+        glDeleteBuffers(1, &this->lightBuffer);
+        glDeleteBuffers(1, &this->clusterBuffer);
+        glDeleteBuffers(1, &this->indexBuffer);
+    }
+
+    int ClusteredLights::getLightCount() {
+        return this->lightCount;
+    }
+
+    int ClusteredLights::getLightIndexCount() {
+        return this->lightIndexCount;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef ClusteredLights_hpp
+#define ClusteredLights_hpp
+
+#include <GL/glew.h>
+
+#include "glm/glm.hpp"
+
+#include "Shader.hpp"
+
+#include <vector>
+
+namespace gps {
+
+    //froxel grid, must match the cluster uniforms read by the shaders
+    const int CLUSTER_COUNT_X = 16;
+    const int CLUSTER_COUNT_Y = 9;
+    const int CLUSTER_COUNT_Z = 24;
+    //upper bound of the lights shaded by a single fragment
+    const int MAX_LIGHTS_PER_CLUSTER = 128;
+
+    struct PointLight {
+        //world coordinates
+        glm::vec3 position;
+        //distance after which the light has no effect
+        float range;
+        glm::vec3 color;
+        //first tile in the shadow atlas, -1 if the light casts no shadow
+        int shadowTile;
+    };
+
+    class ClusteredLights
+    {
+    public:
+        //create the texture buffers holding the lights and the cluster lists
+        void Init();
+        //bin the lights into the view space clusters and upload them
+        void Update(std::vector<PointLight> lights, glm::mat4 view, float fovY, float aspect, float nearPlane, float farPlane);
+        //bind the texture buffers to three consecutive units starting at firstUnit and set the cluster uniforms
+        void Bind(gps::Shader& shader, int firstUnit, int viewportWidth, int viewportHeight);
+        void Delete();
+
+        int getLightCount();
+        //number of light references over all the clusters
+        int getLightIndexCount();
+
+    private:
+        GLuint lightBuffer;
+        GLuint lightTexture;
+        GLuint clusterBuffer;
+        GLuint clusterTexture;
+        GLuint indexBuffer;
+        GLuint indexTexture;
+
+        float nearPlane;
+        float farPlane;
+        int lightCount;
+        int lightIndexCount;
+
+        //per light: position in eye coordinates and range, color and shadow tile, world position
+        std::vector<glm::vec4> lightData;
+        //per cluster: offset and count in lightIndices
+        std::vector<GLuint> clusterData;
+        std::vector<GLuint> lightIndices;
+
+        int computeSlice(float depth);
+        void createTextureBuffer(GLuint& buffer, GLuint& texture, GLenum format);
+    };
+
+}
+
+#endif /* ClusteredLights_hpp */
@@ -0,0 +1,316 @@
+#include "FrameCapture.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace gps {
+
+    //the real stdout once ReserveStdout has run
+    static FILE* reservedStdout = NULL;
+
+    void FrameCapture::ReserveStdout() {
+        if (reservedStdout != NULL) {
+            return;
+        }
+        std::fflush(stdout);
+#ifdef _WIN32
+        int stream = _dup(_fileno(stdout));
+        _setmode(stream, _O_BINARY);
+        reservedStdout = _fdopen(stream, "wb");
+        _dup2(_fileno(stderr), _fileno(stdout));
+#else
+        int stream = dup(fileno(stdout));
+        reservedStdout = fdopen(stream, "wb");
+        dup2(fileno(stderr), fileno(stdout));
+#endif
+    }
+
+    void FrameCapture::Init(int width, int height, ImageFormat format, std::string directory, bool synchronous) {
+        this->width = width;
+        this->height = height;
+        this->format = format;
+        this->directory = directory;
+        this->synchronous = synchronous;
+        this->nextSlot = 0;
+        this->capturedFrames = 0;
+        this->queuedFrames = 0;
+        this->backpressureWaits = 0;
+        this->writtenFrames = 0;
+        this->failedFrames = 0;
+        this->timing = false;
+        this->elapsedSeconds = 0.0;
+        this->stopping = false;
+        this->nextStreamSequence = 0;
+
+        GLsizeiptr size = (GLsizeiptr)width * height * 4;
+        for (int i = 0; i < CAPTURE_RING_SIZE; i++) {
+            glGenBuffers(1, &this->slots[i].buffer);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, this->slots[i].buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+            this->slots[i].fence = 0;
+            this->slots[i].frame = -1;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        //allocated once, the frames cycle between the two queues
+        this->freeFrames.Init(CAPTURE_QUEUE_SIZE);
+        this->encodeQueue.Init(CAPTURE_QUEUE_SIZE);
+        for (int i = 0; i < CAPTURE_QUEUE_SIZE; i++) {
+            this->queuedFrameData[i].pixels.resize((size_t)size);
+            this->freeFrames.TryPush(i);
+        }
+
+        this->stream = NULL;
+        if (format == IMAGE_Y4M) {
+            if (directory == "-") {
+                ReserveStdout();
+                this->stream = reservedStdout;
+            }
+            else {
+                std::string path = directory + "/capture.y4m";
+                this->stream = std::fopen(path.c_str(), "wb");
+                if (this->stream == NULL) {
+                    GPS_LOG_ERROR("Could not open %s", path.c_str());
+                }
+            }
+            if (this->stream != NULL) {
+                std::string header = getY4MHeader(width, height, CAPTURE_Y4M_FRAME_RATE);
+                std::fwrite(header.data(), 1, header.size(), this->stream);
+            }
+        }
+
+        if (!synchronous) {
+            //one core stays with the render thread
+            int threadCount = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+            for (int i = 0; i < threadCount; i++) {
+                this->encoders.push_back(std::thread(&FrameCapture::encoderLoop, this));
+            }
+        }
+    }
+
+    void FrameCapture::Capture(GLuint framebuffer) {
+        if (!this->timing) {
+            this->timing = true;
+            this->start = std::chrono::steady_clock::now();
+        }
+        int frame = this->capturedFrames++;
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+        if (this->synchronous) {
+            //stalls until the frame is done
+            std::vector<unsigned char> pixels((size_t)this->width * this->height * 4);
+            glReadPixels(0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            QueuedFrame& queued = this->queuedFrameData[0];
+            size_t rowSize = (size_t)this->width * 4;
+            for (int y = 0; y < this->height; y++) {
+                std::memcpy(&queued.pixels[y * rowSize], &pixels[(this->height - 1 - y) * rowSize], rowSize);
+            }
+            queued.frame = frame;
+            queued.sequence = this->queuedFrames++;
+            this->encode(queued);
+            return;
+        }
+
+        //the ring is full only if the GPU is CAPTURE_RING_SIZE frames behind
+        Slot& slot = this->slots[this->nextSlot];
+        if (slot.frame >= 0) {
+            this->drain(slot, true);
+        }
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glReadPixels(0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.frame = frame;
+        this->nextSlot = (this->nextSlot + 1) % CAPTURE_RING_SIZE;
+    }
+
+    void FrameCapture::Poll() {
+        //oldest first, so the images are handed out in order
+        for (int i = 0; i < CAPTURE_RING_SIZE; i++) {
+            Slot& slot = this->slots[(this->nextSlot + i) % CAPTURE_RING_SIZE];
+            if (slot.frame >= 0 && !this->drain(slot, false)) {
+                return;
+            }
+        }
+    }
+
+    bool FrameCapture::drain(Slot& slot, bool wait) {
+        GLuint64 timeout = wait ? 1000000000ull : 0;
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+            if (!wait) {
+                return false;
+            }
+            //a second is far past any frame, something went wrong with the context
+            GPS_LOG_WARNING("Frame capture readback did not finish");
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+
+        //copy out of the mapping, only the GL thread may touch it; the rows are flipped on the way
+        int index = this->acquireFrame();
+        QueuedFrame& queued = this->queuedFrameData[index];
+        size_t rowSize = (size_t)this->width * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        const unsigned char* mapped = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, rowSize * this->height, GL_MAP_READ_BIT);
+        if (mapped != NULL) {
+            for (int y = 0; y < this->height; y++) {
+                std::memcpy(&queued.pixels[y * rowSize], mapped + (this->height - 1 - y) * rowSize, rowSize);
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        queued.frame = slot.frame;
+        slot.frame = -1;
+        if (mapped == NULL) {
+            this->failedFrames++;
+            this->freeFrames.TryPush(index);
+            return true;
+        }
+        queued.sequence = this->queuedFrames++;
+        //cannot fail, there are only CAPTURE_QUEUE_SIZE indices
+        this->encodeQueue.TryPush(index);
+        return true;
+    }
+
+    int FrameCapture::acquireFrame() {
+        int index;
+        if (this->freeFrames.TryPop(index)) {
+            return index;
+        }
+        //backpressure, the encoders are behind and the memory of the capture is bounded
+        this->backpressureWaits++;
+        while (!this->freeFrames.TryPop(index)) {
+            std::this_thread::yield();
+        }
+        return index;
+    }
+
+    void FrameCapture::encoderLoop() {
+        int idleSpins = 0;
+        for (;;) {
+            //read before the pop: Finish sets stopping after its last push,
+            //so once the flag is seen an empty queue really is the end
+            bool stop = this->stopping;
+            int index;
+            if (this->encodeQueue.TryPop(index)) {
+                idleSpins = 0;
+                this->encode(this->queuedFrameData[index]);
+                this->freeFrames.TryPush(index);
+            }
+            else if (stop) {
+                return;
+            }
+            else if (++idleSpins < 64) {
+                std::this_thread::yield();
+            }
+            else {
+                //frames come at most once per rendered frame, no need to spin hot
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+    void FrameCapture::encode(QueuedFrame& queued) {
+        std::vector<unsigned char> image = encodeImage(queued.pixels, this->width, this->height, this->format);
+
+        if (this->format == IMAGE_Y4M) {
+            //the frames are converted in parallel but appended in capture order
+            while (this->nextStreamSequence.load(std::memory_order_acquire) != queued.sequence) {
+                std::this_thread::yield();
+            }
+            bool written = this->stream != NULL && std::fwrite(&image[0], 1, image.size(), this->stream) == image.size();
+            if (written) {
+                this->writtenFrames++;
+            }
+            else {
+                this->failedFrames++;
+            }
+            this->nextStreamSequence.store(queued.sequence + 1, std::memory_order_release);
+            return;
+        }
+
+        std::string path = this->getPath(queued.frame);
+        std::ofstream file(path, std::ios::binary);
+        file.write((const char*)&image[0], image.size());
+        if (file) {
+            this->writtenFrames++;
+        }
+        else {
+            this->failedFrames++;
+            GPS_LOG_ERROR("Could not write %s", path.c_str());
+        }
+    }
+
+    std::string FrameCapture::getPath(int frame) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/frame_%04d", frame);
+        return this->directory + name + getImageExtension(this->format);
+    }
+
+    void FrameCapture::Finish() {
+        if (!this->synchronous) {
+            for (int i = 0; i < CAPTURE_RING_SIZE; i++) {
+                Slot& slot = this->slots[(this->nextSlot + i) % CAPTURE_RING_SIZE];
+                if (slot.frame >= 0) {
+                    this->drain(slot, true);
+                }
+            }
+            this->stopping = true;
+            for (size_t i = 0; i < this->encoders.size(); i++) {
+                this->encoders[i].join();
+            }
+            this->encoders.clear();
+        }
+        if (this->stream != NULL) {
+            std::fflush(this->stream);
+        }
+        if (this->timing) {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - this->start;
+            this->elapsedSeconds = elapsed.count();
+        }
+    }
+
+    void FrameCapture::Delete() {
+        for (int i = 0; i < CAPTURE_RING_SIZE; i++) {
+            if (this->slots[i].fence != 0) {
+                glDeleteSync(this->slots[i].fence);
+            }
+            glDeleteBuffers(1, &this->slots[i].buffer);
+        }
+        if (this->stream != NULL && this->stream != reservedStdout) {
+            std::fclose(this->stream);
+        }
+        this->stream = NULL;
+        for (int i = 0; i < CAPTURE_QUEUE_SIZE; i++) {
+            std::vector<unsigned char>().swap(this->queuedFrameData[i].pixels);
+        }
+    }
+
+    int FrameCapture::getCapturedFrames() {
+        return this->writtenFrames;
+    }
+
+    double FrameCapture::getFramesPerSecond() {
+        return this->elapsedSeconds > 0.0 ? this->writtenFrames / this->elapsedSeconds : 0.0;
+    }
+
+    int FrameCapture::getBackpressureWaits() {
+        return this->backpressureWaits;
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef FrameCapture_hpp
+#define FrameCapture_hpp
+
+#include <GL/glew.h>
+
+#include "BoundedQueue.hpp"
+#include "ImageEncoder.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace gps {
+
+    //buffers in the readback ring, a frame is mapped this many captures after it was read
+    const int CAPTURE_RING_SIZE = 3;
+    //frames copied out of the ring and waiting for an encoder, bounds the memory of the capture
+    const int CAPTURE_QUEUE_SIZE = 8;
+    //frame rate written in the Y4M header
+    const int CAPTURE_Y4M_FRAME_RATE = 30;
+
+    //reads frames back through a ring of pixel buffer objects guarded by fences,
+    //so glReadPixels returns at once and the copy lands while later frames render;
+    //the pixels go through a lock-free queue to encoder threads that do all the disk writes
+    class FrameCapture
+    {
+    public:
+        //synchronous - plain glReadPixels and encoding on the calling thread, for comparison;
+        //Y4M frames are appended to directory/capture.y4m, or to stdout if directory is "-"
+        void Init(int width, int height, ImageFormat format, std::string directory, bool synchronous);
+        //points stdout at stderr and keeps the real stdout for the Y4M stream of directory "-",
+        //so nothing printed ends up inside the stream; call before anything is printed
+        static void ReserveStdout();
+        //read the color attachment of the framebuffer and save it as the next image
+        void Capture(GLuint framebuffer);
+        //hand the readbacks that have landed to the encoders, waits only if every queued frame is still encoding
+        void Poll();
+        //wait for every readback and every image to be written, stops the encoders
+        void Finish();
+        void Delete();
+
+        int getCapturedFrames();
+        //written images per second, from the first capture to the end of Finish
+        double getFramesPerSecond();
+        //times the render thread waited for an encoder to free a frame
+        int getBackpressureWaits();
+
+    private:
+        struct Slot {
+            GLuint buffer;
+            GLsync fence;
+            //image number, -1 if the slot is free
+            int frame;
+        };
+
+        //a frame copied out of the ring, owned by whoever popped its index from a queue
+        struct QueuedFrame {
+            std::vector<unsigned char> pixels;
+            int frame;
+            //position in the Y4M stream
+            int sequence;
+        };
+
+        int width;
+        int height;
+        ImageFormat format;
+        std::string directory;
+        bool synchronous;
+
+        Slot slots[CAPTURE_RING_SIZE];
+        int nextSlot;
+        int capturedFrames;
+        int queuedFrames;
+        int backpressureWaits;
+        std::atomic<int> writtenFrames;
+        std::atomic<int> failedFrames;
+        bool timing;
+        std::chrono::steady_clock::time_point start;
+        double elapsedSeconds;
+
+        QueuedFrame queuedFrameData[CAPTURE_QUEUE_SIZE];
+        BoundedQueue<int> freeFrames;
+        BoundedQueue<int> encodeQueue;
+        std::vector<std::thread> encoders;
+        std::atomic<bool> stopping;
+
+        FILE* stream;
+        //next sequence to append to the stream, the encoders finish out of order
+        std::atomic<int> nextStreamSequence;
+
+        //map the buffer of the slot, waiting for its fence if wait is set
+        bool drain(Slot& slot, bool wait);
+        //index of a free frame, waits for the encoders if all of them are queued
+        int acquireFrame();
+        void encoderLoop();
+        void encode(QueuedFrame& queued);
+        std::string getPath(int frame);
+    };
+
+}
+
+#endif /* FrameCapture_hpp */
@@ -0,0 +1,293 @@
+#include "FrameGraph.hpp"
+#include "GLStateCache.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace gps {
+
+    //pooled textures unused for this many frames are freed, so disabled passes cost no memory
+    const int POOL_MAX_IDLE_FRAMES = 3;
+
+    bool FrameGraphTextureDesc::operator==(const FrameGraphTextureDesc& other) const {
+        return this->width == other.width && this->height == other.height &&
+            this->internalFormat == other.internalFormat &&
+            this->format == other.format && this->type == other.type;
+    }
+
+    static size_t bytesPerPixel(GLint internalFormat) {
+        switch (internalFormat) {
+        case GL_R8:
+            return 1;
+        case GL_RG8:
+        case GL_R16F:
+            return 2;
+        case GL_RGBA16F:
+        case GL_RG32F:
+            return 8;
+        case GL_RGBA32F:
+            return 16;
+        default:
+            //RGBA8, RG16, R32F and the 24 and 32 bit depth formats
+            return 4;
+        }
+    }
+
+    FrameGraphBuilder::FrameGraphBuilder(FrameGraph& graph, int pass) : graph(graph), pass(pass) {
+    }
+
+    FrameGraphResource FrameGraphBuilder::Create(std::string name, FrameGraphTextureDesc desc) {
+        FrameGraph::ResourceNode node;
+        node.name = name;
+        node.imported = false;
+        node.output = false;
+        node.texture = 0;
+        node.desc = desc;
+        node.firstUse = -1;
+        node.lastUse = -1;
+        this->graph.resources.push_back(node);
+        return (FrameGraphResource)this->graph.resources.size() - 1;
+    }
+
+    FrameGraphResource FrameGraphBuilder::Read(FrameGraphResource resource) {
+        this->graph.passes[this->pass].reads.push_back(resource);
+        return resource;
+    }
+
+    FrameGraphResource FrameGraphBuilder::Write(FrameGraphResource resource) {
+        this->graph.passes[this->pass].writes.push_back(resource);
+        this->graph.resources[resource].writers.push_back(this->pass);
+        return resource;
+    }
+
+    FrameGraphResource FrameGraph::Import(std::string name, GLuint texture, bool output) {
+        ResourceNode node;
+        node.name = name;
+        node.imported = true;
+        node.output = output;
+        node.texture = texture;
+        node.desc = FrameGraphTextureDesc{ 0, 0, 0, 0, 0 };
+        node.firstUse = -1;
+        node.lastUse = -1;
+        this->resources.push_back(node);
+        return (FrameGraphResource)this->resources.size() - 1;
+    }
+
+    void FrameGraph::AddPass(std::string name, std::function<void(FrameGraphBuilder&)> setup, std::function<void(FrameGraph&)> execute) {
+        PassNode node;
+        node.name = name;
+        node.execute = execute;
+        node.culled = false;
+        this->passes.push_back(node);
+
+        FrameGraphBuilder builder(*this, (int)this->passes.size() - 1);
+        setup(builder);
+    }
+
+    void FrameGraph::Compile() {
+        int passCount = (int)this->passes.size();
+
+        //writes of the same resource keep their declaration order, a read waits for the writers declared
+        //before it, or for all of them when it is declared ahead of its producers
+        for (int p = 0; p < passCount; p++) {
+            PassNode& pass = this->passes[p];
+            pass.dependencies.clear();
+
+            for (int resource : pass.writes) {
+                std::vector<int>& writers = this->resources[resource].writers;
+                std::vector<int>::iterator self = std::find(writers.begin(), writers.end(), p);
+                if (self != writers.begin()) {
+                    pass.dependencies.push_back(*(self - 1));
+                }
+            }
+            for (int resource : pass.reads) {
+                std::vector<int>& writers = this->resources[resource].writers;
+                bool producedBefore = !writers.empty() && writers.front() < p;
+                for (int writer : writers) {
+                    if (writer != p && (!producedBefore || writer < p)) {
+                        pass.dependencies.push_back(writer);
+                    }
+                }
+            }
+        }
+
+        //keep only the passes an output depends on
+        std::vector<bool> needed(passCount, false);
+        std::vector<int> stack;
+        for (ResourceNode& resource : this->resources) {
+            if (resource.output) {
+                for (int writer : resource.writers) {
+                    stack.push_back(writer);
+                }
+            }
+        }
+        while (!stack.empty()) {
+            int p = stack.back();
+            stack.pop_back();
+            if (needed[p]) {
+                continue;
+            }
+            needed[p] = true;
+            for (int dependency : this->passes[p].dependencies) {
+                stack.push_back(dependency);
+            }
+        }
+
+        //Kahn's algorithm, ties broken by declaration order
+        std::vector<int> pending(passCount, 0);
+        std::vector<std::vector<int>> dependents(passCount);
+        for (int p = 0; p < passCount; p++) {
+            this->passes[p].culled = !needed[p];
+            if (!needed[p]) {
+                continue;
+            }
+            for (int dependency : this->passes[p].dependencies) {
+                pending[p]++;
+                dependents[dependency].push_back(p);
+            }
+        }
+
+        this->executionOrder.clear();
+        std::vector<int> ready;
+        for (int p = 0; p < passCount; p++) {
+            if (needed[p] && pending[p] == 0) {
+                ready.push_back(p);
+            }
+        }
+        while (!ready.empty()) {
+            std::vector<int>::iterator first = std::min_element(ready.begin(), ready.end());
+            int p = *first;
+            ready.erase(first);
+            this->executionOrder.push_back(p);
+            for (int dependent : dependents[p]) {
+                if (--pending[dependent] == 0) {
+                    ready.push_back(dependent);
+                }
+            }
+        }
+
+        int neededCount = (int)std::count(needed.begin(), needed.end(), true);
+        if ((int)this->executionOrder.size() != neededCount) {
+            throw std::runtime_error("Frame graph passes form a cycle");
+        }
+
+        //lifetime of the transient textures over the execution order
+        for (int i = 0; i < (int)this->executionOrder.size(); i++) {
+            PassNode& pass = this->passes[this->executionOrder[i]];
+            std::vector<int> used(pass.reads);
+            used.insert(used.end(), pass.writes.begin(), pass.writes.end());
+            for (int resource : used) {
+                ResourceNode& node = this->resources[resource];
+                if (node.firstUse < 0) {
+                    node.firstUse = i;
+                }
+                node.lastUse = i;
+            }
+        }
+
+        this->stats.executedPasses = (int)this->executionOrder.size();
+        this->stats.culledPasses = passCount - this->stats.executedPasses;
+    }
+
+    void FrameGraph::Execute() {
+        for (int i = 0; i < (int)this->executionOrder.size(); i++) {
+            for (ResourceNode& resource : this->resources) {
+                if (!resource.imported && resource.firstUse == i) {
+                    resource.texture = this->acquireTexture(resource.desc);
+                }
+            }
+
+            PassNode& pass = this->passes[this->executionOrder[i]];
+            {
+                ProfileScope scope(pass.name);
+                pass.execute(*this);
+            }
+
+            //textures released here can back a later resource with the same description
+            for (ResourceNode& resource : this->resources) {
+                if (!resource.imported && resource.lastUse == i) {
+                    this->releaseTexture(resource.texture);
+                }
+            }
+        }
+
+        this->trimPool();
+        this->frame++;
+    }
+
+    void FrameGraph::Reset() {
+        this->resources.clear();
+        this->passes.clear();
+        this->executionOrder.clear();
+    }
+
+    void FrameGraph::Delete() {
+        for (PooledTexture& pooled : this->pool) {
+            GLStateCache::get().ForgetTexture(pooled.texture);
+            glDeleteTextures(1, &pooled.texture);
+        }
+        this->pool.clear();
+        this->Reset();
+    }
+
+    GLuint FrameGraph::getTexture(FrameGraphResource resource) {
+        return this->resources[resource].texture;
+    }
+
+    FrameGraphStats FrameGraph::getStats() {
+        this->stats.pooledTextures = (int)this->pool.size();
+        this->stats.pooledBytes = 0;
+        for (PooledTexture& pooled : this->pool) {
+            this->stats.pooledBytes += (size_t)pooled.desc.width * pooled.desc.height * bytesPerPixel(pooled.desc.internalFormat);
+        }
+        return this->stats;
+    }
+
+    GLuint FrameGraph::acquireTexture(FrameGraphTextureDesc desc) {
+        for (PooledTexture& pooled : this->pool) {
+            if (!pooled.inUse && pooled.desc == desc) {
+                pooled.inUse = true;
+                pooled.lastUsedFrame = this->frame;
+                return pooled.texture;
+            }
+        }
+
+        PooledTexture pooled;
+        pooled.desc = desc;
+        pooled.inUse = true;
+        pooled.lastUsedFrame = this->frame;
+        glGenTextures(1, &pooled.texture);
+        GLStateCache::get().BindTexture(0, GL_TEXTURE_2D, pooled.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, desc.format, desc.type, NULL);
+        //render targets are read with texelFetch or at pixel centers
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        this->pool.push_back(pooled);
+        return pooled.texture;
+    }
+
+    void FrameGraph::releaseTexture(GLuint texture) {
+        for (PooledTexture& pooled : this->pool) {
+            if (pooled.texture == texture) {
+                pooled.inUse = false;
+                return;
+            }
+        }
+    }
+
+    void FrameGraph::trimPool() {
+        for (size_t i = 0; i < this->pool.size();) {
+            if (!this->pool[i].inUse && this->frame - this->pool[i].lastUsedFrame >= POOL_MAX_IDLE_FRAMES) {
+                GLStateCache::get().ForgetTexture(this->pool[i].texture);
+                glDeleteTextures(1, &this->pool[i].texture);
+                this->pool.erase(this->pool.begin() + i);
+            }
+            else {
+                i++;
+            }
+        }
+    }
+}
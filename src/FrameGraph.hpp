@@ -0,0 +1,116 @@
+#ifndef FrameGraph_hpp
+#define FrameGraph_hpp
+
+#include <GL/glew.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    //handle of a resource inside the graph of the current frame
+    typedef int FrameGraphResource;
+
+    struct FrameGraphTextureDesc {
+        int width;
+        int height;
+        GLint internalFormat;
+        GLenum format;
+        GLenum type;
+
+        bool operator==(const FrameGraphTextureDesc& other) const;
+    };
+
+    struct FrameGraphStats {
+        int executedPasses = 0;
+        int culledPasses = 0;
+        //textures owned by the pool, in use or kept for the next frames
+        int pooledTextures = 0;
+        size_t pooledBytes = 0;
+    };
+
+    class FrameGraph;
+
+    //given to the setup function of a pass to declare what the pass touches
+    class FrameGraphBuilder
+    {
+    public:
+        FrameGraphBuilder(FrameGraph& graph, int pass);
+        //a transient texture, allocated from the pool right before its first use
+        FrameGraphResource Create(std::string name, FrameGraphTextureDesc desc);
+        FrameGraphResource Read(FrameGraphResource resource);
+        FrameGraphResource Write(FrameGraphResource resource);
+
+    private:
+        FrameGraph& graph;
+        int pass;
+    };
+
+    //passes declare their reads and writes, the graph culls the passes that do not contribute
+    //to an output, orders the rest and lets transient textures with the same description share memory
+    class FrameGraph
+    {
+    public:
+        //a texture that lives outside the graph, the writers of an output resource are never culled
+        FrameGraphResource Import(std::string name, GLuint texture, bool output);
+        //setup runs immediately, execute runs from Execute if the pass is not culled
+        void AddPass(std::string name, std::function<void(FrameGraphBuilder&)> setup, std::function<void(FrameGraph&)> execute);
+        //cull, order and compute the lifetime of the transient textures, throws if the passes form a cycle
+        void Compile();
+        void Execute();
+        //drop the passes and resources of the frame, the texture pool is kept
+        void Reset();
+        void Delete();
+
+        //only valid while the pass that declared the resource is executing
+        GLuint getTexture(FrameGraphResource resource);
+        FrameGraphStats getStats();
+
+    private:
+        friend class FrameGraphBuilder;
+
+        struct ResourceNode {
+            std::string name;
+            bool imported;
+            bool output;
+            GLuint texture;
+            FrameGraphTextureDesc desc;
+            std::vector<int> writers;
+            //position in the execution order of the first and last pass using it
+            int firstUse;
+            int lastUse;
+        };
+
+        struct PassNode {
+            std::string name;
+            std::function<void(FrameGraph&)> execute;
+            std::vector<int> reads;
+            std::vector<int> writes;
+            //passes that have to run before this one
+            std::vector<int> dependencies;
+            bool culled;
+        };
+
+        struct PooledTexture {
+            FrameGraphTextureDesc desc;
+            GLuint texture;
+            bool inUse;
+            int lastUsedFrame;
+        };
+
+        std::vector<ResourceNode> resources;
+        std::vector<PassNode> passes;
+        std::vector<int> executionOrder;
+        std::vector<PooledTexture> pool;
+        int frame = 0;
+        FrameGraphStats stats;
+
+        GLuint acquireTexture(FrameGraphTextureDesc desc);
+        void releaseTexture(GLuint texture);
+        void trimPool();
+    };
+
+}
+
+#endif /* FrameGraph_hpp */
@@ -0,0 +1,75 @@
+#include "GBuffer.hpp"
+#include "GLStateCache.hpp"
+
+namespace gps {
+
+    void GBuffer::Init(int width, int height) {
+        this->width = width;
+        this->height = height;
+
+        glGenFramebuffers(1, &this->framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+        GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, drawBuffers);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glGenVertexArrays(1, &this->fullScreenVAO);
+    }
+
+    FrameGraphTextureDesc GBuffer::getAttachmentDesc(GBufferAttachment attachment) {
+        //8 bytes per pixel of color data, the lighting pass rebuilds the position from the depth
+        switch (attachment) {
+        case GBUFFER_ALBEDO_SPEC:
+            return FrameGraphTextureDesc{ this->width, this->height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE };
+        case GBUFFER_NORMAL:
+            return FrameGraphTextureDesc{ this->width, this->height, GL_RG16, GL_RG, GL_UNSIGNED_SHORT };
+        default:
+            return FrameGraphTextureDesc{ this->width, this->height, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT };
+        }
+    }
+
+    void GBuffer::BindForGeometry(GLuint albedoSpec, GLuint normal, GLuint depth) {
+        this->albedoSpecTexture = albedoSpec;
+        this->normalTexture = normal;
+        this->depthTexture = depth;
+
+        //the pool may hand out different textures from one frame to the next
+        glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpec, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        glViewport(0, 0, this->width, this->height);
+        //the color attachments are only read where a surface was drawn
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    void GBuffer::BindTextures(gps::Shader& shader, int firstUnit) {
+        shader.useShaderProgram();
+
+        GLStateCache& state = GLStateCache::get();
+        state.BindTexture(firstUnit, GL_TEXTURE_2D, this->albedoSpecTexture);
+        glUniform1i(shader.getUniformLocation("gAlbedoSpec"), firstUnit);
+        state.BindTexture(firstUnit + 1, GL_TEXTURE_2D, this->normalTexture);
+        glUniform1i(shader.getUniformLocation("gNormal"), firstUnit + 1);
+        state.BindTexture(firstUnit + 2, GL_TEXTURE_2D, this->depthTexture);
+        glUniform1i(shader.getUniformLocation("gDepth"), firstUnit + 2);
+    }
+
+    void GBuffer::DrawFullScreen() {
+        GLStateCache::get().BindVertexArray(this->fullScreenVAO);
+        GLStateCache::get().DrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    void GBuffer::Delete() {
+        glDeleteFramebuffers(1, &this->framebuffer);
+        glDeleteVertexArrays(1, &this->fullScreenVAO);
+    }
+
+    int GBuffer::getWidth() {
+        return this->width;
+    }
+
+    int GBuffer::getHeight() {
+        return this->height;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef GBuffer_hpp
+#define GBuffer_hpp
+
+#include <GL/glew.h>
+
+#include "glm/glm.hpp"
+
+#include "Shader.hpp"
+#include "FrameGraph.hpp"
+
+namespace gps {
+
+    enum GBufferAttachment {
+        GBUFFER_ALBEDO_SPEC,
+        GBUFFER_NORMAL,
+        GBUFFER_DEPTH
+    };
+
+    class GBuffer
+    {
+    public:
+        //the attachments are transient frame graph textures, only the framebuffer is kept here
+        void Init(int width, int height);
+        //albedo and specular intensity (RGBA8), octahedral eye space normals (RG16) and depth
+        FrameGraphTextureDesc getAttachmentDesc(GBufferAttachment attachment);
+        //attach the textures of this frame, bind the G-buffer as the render target and clear its depth
+        void BindForGeometry(GLuint albedoSpec, GLuint normal, GLuint depth);
+        //bind the three attachments to consecutive units starting at firstUnit
+        void BindTextures(gps::Shader& shader, int firstUnit);
+        //full screen triangle for the lighting pass
+        void DrawFullScreen();
+        void Delete();
+
+        int getWidth();
+        int getHeight();
+
+    private:
+        GLuint framebuffer;
+        GLuint albedoSpecTexture;
+        GLuint normalTexture;
+        GLuint depthTexture;
+        GLuint fullScreenVAO;
+        int width;
+        int height;
+    };
+
+}
+
+#endif /* GBuffer_hpp */
@@ -0,0 +1,178 @@
+#include "GLStateCache.hpp"
+
+namespace gps {
+
+    GLStateCache& GLStateCache::get() {
+        //one per process, the application has a single context
+        static GLStateCache cache;
+        return cache;
+    }
+
+    GLStateCache::GLStateCache() {
+        this->Invalidate();
+    }
+
+    void GLStateCache::Invalidate() {
+        this->program = UNKNOWN;
+        this->vertexArray = UNKNOWN;
+        this->activeUnit = UNKNOWN;
+        for (int unit = 0; unit < MAX_CACHED_TEXTURE_UNITS; unit++) {
+            for (int target = 0; target < TARGET_COUNT; target++) {
+                this->textures[unit][target] = UNKNOWN;
+            }
+        }
+        for (int capability = 0; capability < CAP_COUNT; capability++) {
+            this->capabilities[capability] = UNKNOWN;
+        }
+        this->depthFunc = UNKNOWN;
+        this->depthMask = UNKNOWN;
+        this->blendSource = UNKNOWN;
+        this->blendDestination = UNKNOWN;
+        this->colorMask = UNKNOWN;
+    }
+
+    bool GLStateCache::change(GLuint& current, GLuint value) {
+        if (current == value) {
+            this->stats.skippedCalls++;
+            return false;
+        }
+        current = value;
+        this->stats.issuedCalls++;
+        return true;
+    }
+
+    void GLStateCache::UseProgram(GLuint program) {
+        if (this->change(this->program, program)) {
+            glUseProgram(program);
+        }
+    }
+
+    void GLStateCache::BindVertexArray(GLuint vertexArray) {
+        if (this->change(this->vertexArray, vertexArray)) {
+            glBindVertexArray(vertexArray);
+        }
+    }
+
+    void GLStateCache::activateUnit(int unit) {
+        if (this->change(this->activeUnit, (GLuint)unit)) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+    }
+
+    void GLStateCache::BindTexture(int unit, GLenum target, GLuint texture) {
+        int index = this->targetIndex(target);
+        if (unit >= MAX_CACHED_TEXTURE_UNITS || index < 0) {
+            //not tracked, always issued
+            this->activateUnit(unit);
+            glBindTexture(target, texture);
+            this->stats.issuedCalls++;
+            return;
+        }
+        if (this->textures[unit][index] == texture) {
+            this->stats.skippedCalls++;
+            return;
+        }
+        this->activateUnit(unit);
+        this->change(this->textures[unit][index], texture);
+        glBindTexture(target, texture);
+    }
+
+    void GLStateCache::ForgetTexture(GLuint texture) {
+        for (int unit = 0; unit < MAX_CACHED_TEXTURE_UNITS; unit++) {
+            for (int target = 0; target < TARGET_COUNT; target++) {
+                if (this->textures[unit][target] == texture) {
+                    this->textures[unit][target] = 0;
+                }
+            }
+        }
+    }
+
+    void GLStateCache::SetEnabled(GLenum capability, bool enabled) {
+        int index = this->capabilityIndex(capability);
+        if (index >= 0 && !this->change(this->capabilities[index], enabled ? 1 : 0)) {
+            return;
+        }
+        if (index < 0) {
+            this->stats.issuedCalls++;
+        }
+        if (enabled) {
+            glEnable(capability);
+        }
+        else {
+            glDisable(capability);
+        }
+    }
+
+    void GLStateCache::DepthFunc(GLenum func) {
+        if (this->change(this->depthFunc, func)) {
+            glDepthFunc(func);
+        }
+    }
+
+    void GLStateCache::DepthMask(GLboolean mask) {
+        if (this->change(this->depthMask, mask)) {
+            glDepthMask(mask);
+        }
+    }
+
+    void GLStateCache::BlendFunc(GLenum sourceFactor, GLenum destinationFactor) {
+        if (this->blendSource == sourceFactor && this->blendDestination == destinationFactor) {
+            this->stats.skippedCalls++;
+            return;
+        }
+        this->blendSource = sourceFactor;
+        this->blendDestination = destinationFactor;
+        this->stats.issuedCalls++;
+        glBlendFunc(sourceFactor, destinationFactor);
+    }
+
+    void GLStateCache::ColorMask(GLboolean mask) {
+        if (this->change(this->colorMask, mask)) {
+            glColorMask(mask, mask, mask, mask);
+        }
+    }
+
+    void GLStateCache::DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+        glDrawElements(mode, count, type, indices);
+        this->stats.drawCalls++;
+        if (mode == GL_TRIANGLES) {
+            this->stats.triangles += count / 3;
+        }
+    }
+
+    void GLStateCache::DrawArrays(GLenum mode, GLint first, GLsizei count) {
+        glDrawArrays(mode, first, count);
+        this->stats.drawCalls++;
+        if (mode == GL_TRIANGLES) {
+            this->stats.triangles += count / 3;
+        }
+    }
+
+    void GLStateCache::ResetStats() {
+        this->stats = GLStateStats();
+    }
+
+    GLStateStats GLStateCache::getStats() {
+        return this->stats;
+    }
+
+    int GLStateCache::targetIndex(GLenum target) {
+        switch (target) {
+        case GL_TEXTURE_2D: return TARGET_2D;
+        case GL_TEXTURE_2D_ARRAY: return TARGET_2D_ARRAY;
+        case GL_TEXTURE_CUBE_MAP: return TARGET_CUBE_MAP;
+        case GL_TEXTURE_BUFFER: return TARGET_BUFFER;
+        default: return -1;
+        }
+    }
+
+    int GLStateCache::capabilityIndex(GLenum capability) {
+        switch (capability) {
+        case GL_BLEND: return CAP_BLEND;
+        case GL_DEPTH_TEST: return CAP_DEPTH_TEST;
+        case GL_CULL_FACE: return CAP_CULL_FACE;
+        case GL_SCISSOR_TEST: return CAP_SCISSOR_TEST;
+        default: return -1;
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef GLStateCache_hpp
+#define GLStateCache_hpp
+
+#include <GL/glew.h>
+
+namespace gps {
+
+    //texture units tracked by the cache
+    const int MAX_CACHED_TEXTURE_UNITS = 16;
+
+    struct GLStateStats {
+        //state changes sent to the driver
+        int issuedCalls = 0;
+        //state changes dropped because the state was already set
+        int skippedCalls = 0;
+        int drawCalls = 0;
+        int triangles = 0;
+    };
+
+    //shadows the bound program, vertex array, textures and the blend and depth state
+    //so that setting a state that is already current costs no GL call
+    //all the state it tracks must be changed through it
+    class GLStateCache
+    {
+    public:
+        static GLStateCache& get();
+
+        void UseProgram(GLuint program);
+        void BindVertexArray(GLuint vertexArray);
+        //GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP or GL_TEXTURE_BUFFER
+        void BindTexture(int unit, GLenum target, GLuint texture);
+        //GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE or GL_SCISSOR_TEST
+        void SetEnabled(GLenum capability, bool enabled);
+        void DepthFunc(GLenum func);
+        void DepthMask(GLboolean mask);
+        void BlendFunc(GLenum sourceFactor, GLenum destinationFactor);
+        void ColorMask(GLboolean mask);
+
+        void DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices);
+        void DrawArrays(GLenum mode, GLint first, GLsizei count);
+
+        //call before glDeleteTextures: GL unbinds a deleted texture from every unit,
+        //and the name may come back from glGenTextures for a new texture
+        void ForgetTexture(GLuint texture);
+        //forget the shadowed state, for code that changed it with direct GL calls
+        void Invalidate();
+        void ResetStats();
+        GLStateStats getStats();
+
+    private:
+        enum TextureTarget { TARGET_2D, TARGET_2D_ARRAY, TARGET_CUBE_MAP, TARGET_BUFFER, TARGET_COUNT };
+        enum Capability { CAP_BLEND, CAP_DEPTH_TEST, CAP_CULL_FACE, CAP_SCISSOR_TEST, CAP_COUNT };
+        //value of a state that is not known, the next change is always issued
+        static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+        GLuint program;
+        GLuint vertexArray;
+        GLuint activeUnit;
+        GLuint textures[MAX_CACHED_TEXTURE_UNITS][TARGET_COUNT];
+        GLuint capabilities[CAP_COUNT];
+        GLuint depthFunc;
+        GLuint depthMask;
+        GLuint blendSource;
+        GLuint blendDestination;
+        GLuint colorMask;
+        GLStateStats stats;
+
+        GLStateCache();
+        //true if the state has to be sent to the driver, updates the counters
+        bool change(GLuint& current, GLuint value);
+        void activateUnit(int unit);
+        int targetIndex(GLenum target);
+        int capabilityIndex(GLenum capability);
+    };
+
+}
+
+#endif /* GLStateCache_hpp */
@@ -0,0 +1,467 @@
+#include "ImageEncoder.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+namespace gps {
+
+    static void writeBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+        out.push_back((unsigned char)(value >> 24));
+        out.push_back((unsigned char)(value >> 16));
+        out.push_back((unsigned char)(value >> 8));
+        out.push_back((unsigned char)value);
+    }
+
+    static std::vector<unsigned char> encodePPM(const std::vector<unsigned char>& rgba, int width, int height) {
+        std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        std::vector<unsigned char> out(header.begin(), header.end());
+        out.reserve(header.size() + (size_t)width * height * 3);
+        for (size_t i = 0; i < rgba.size(); i += 4) {
+            out.push_back(rgba[i]);
+            out.push_back(rgba[i + 1]);
+            out.push_back(rgba[i + 2]);
+        }
+        return out;
+    }
+
+    //https://qoiformat.org/qoi-specification.pdf
+    static std::vector<unsigned char> encodeQOI(const std::vector<unsigned char>& rgba, int width, int height) {
+        std::vector<unsigned char> out;
+        out.reserve(14 + (size_t)width * height * 2);
+        out.push_back('q');
+        out.push_back('o');
+        out.push_back('i');
+        out.push_back('f');
+        writeBigEndian(out, (uint32_t)width);
+        writeBigEndian(out, (uint32_t)height);
+        //RGB, blended glass leaves the framebuffer alpha below 1 and the captures are meant opaque like PPM
+        out.push_back(3);
+        //sRGB with linear alpha
+        out.push_back(0);
+
+        unsigned char index[64][4];
+        std::memset(index, 0, sizeof(index));
+        unsigned char previous[4] = { 0, 0, 0, 255 };
+        int run = 0;
+        size_t pixelCount = (size_t)width * height;
+
+        for (size_t i = 0; i < pixelCount; i++) {
+            unsigned char pixel[4] = { rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2], 255 };
+            if (std::memcmp(pixel, previous, 4) == 0) {
+                run++;
+                if (run == 62 || i == pixelCount - 1) {
+                    out.push_back((unsigned char)(0xC0 | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0) {
+                out.push_back((unsigned char)(0xC0 | (run - 1)));
+                run = 0;
+            }
+
+            int hash = (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+            if (std::memcmp(index[hash], pixel, 4) == 0) {
+                out.push_back((unsigned char)hash);
+            }
+            else {
+                std::memcpy(index[hash], pixel, 4);
+                if (pixel[3] == previous[3]) {
+                    signed char dr = (signed char)(pixel[0] - previous[0]);
+                    signed char dg = (signed char)(pixel[1] - previous[1]);
+                    signed char db = (signed char)(pixel[2] - previous[2]);
+                    signed char drg = (signed char)(dr - dg);
+                    signed char dbg = (signed char)(db - dg);
+
+                    if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+                        out.push_back((unsigned char)(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                    }
+                    else if (drg > -9 && drg < 8 && dg > -33 && dg < 32 && dbg > -9 && dbg < 8) {
+                        out.push_back((unsigned char)(0x80 | (dg + 32)));
+                        out.push_back((unsigned char)((drg + 8) << 4 | (dbg + 8)));
+                    }
+                    else {
+                        out.push_back(0xFE);
+                        out.push_back(pixel[0]);
+                        out.push_back(pixel[1]);
+                        out.push_back(pixel[2]);
+                    }
+                }
+                else {
+                    out.push_back(0xFF);
+                    out.insert(out.end(), pixel, pixel + 4);
+                }
+            }
+            std::memcpy(previous, pixel, 4);
+        }
+
+        for (int i = 0; i < 7; i++) {
+            out.push_back(0);
+        }
+        out.push_back(1);
+        return out;
+    }
+
+    static std::vector<uint32_t> buildCrcTable() {
+        std::vector<uint32_t> table(256);
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        return table;
+    }
+
+    static uint32_t crc32(const unsigned char* data, size_t length, uint32_t crc) {
+        //built once, the encoders run on several threads
+        static const std::vector<uint32_t> table = buildCrcTable();
+
+        crc = ~crc;
+        for (size_t i = 0; i < length; i++) {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    static void writeChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data) {
+        writeBigEndian(out, (uint32_t)data.size());
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        writeBigEndian(out, crc32(&out[start], out.size() - start, 0));
+    }
+
+    //deflate output, bits are packed starting at the least significant one
+    struct BitWriter {
+        std::vector<unsigned char>& out;
+        uint32_t buffer;
+        int count;
+
+        BitWriter(std::vector<unsigned char>& out) : out(out), buffer(0), count(0) {}
+
+        void write(uint32_t bits, int length) {
+            buffer |= bits << count;
+            count += length;
+            while (count >= 8) {
+                out.push_back((unsigned char)buffer);
+                buffer >>= 8;
+                count -= 8;
+            }
+        }
+
+        //Huffman codes are stored starting at their most significant bit
+        void writeCode(uint32_t code, int length) {
+            uint32_t reversed = 0;
+            for (int i = 0; i < length; i++) {
+                reversed = (reversed << 1) | ((code >> i) & 1);
+            }
+            write(reversed, length);
+        }
+
+        void flush() {
+            if (count > 0) {
+                out.push_back((unsigned char)buffer);
+            }
+            buffer = 0;
+            count = 0;
+        }
+    };
+
+    static const int LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const int LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const int DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static const int DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    //literal/length symbol with the fixed Huffman code of RFC 1951 3.2.6
+    static void writeFixedSymbol(BitWriter& bits, int symbol) {
+        if (symbol < 144) {
+            bits.writeCode(0x30 + symbol, 8);
+        }
+        else if (symbol < 256) {
+            bits.writeCode(0x190 + symbol - 144, 9);
+        }
+        else if (symbol < 280) {
+            bits.writeCode(symbol - 256, 7);
+        }
+        else {
+            bits.writeCode(0xC0 + symbol - 280, 8);
+        }
+    }
+
+    static void writeMatch(BitWriter& bits, int length, int distance) {
+        int code = 28;
+        while (LENGTH_BASE[code] > length) {
+            code--;
+        }
+        writeFixedSymbol(bits, 257 + code);
+        bits.write(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+
+        code = 29;
+        while (DISTANCE_BASE[code] > distance) {
+            code--;
+        }
+        bits.writeCode(code, 5);
+        bits.write(distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+    }
+
+    //one fixed Huffman block; LZ77 over a 32 KB window with hash chains,
+    //the chains are kept short since every encoder thread compresses a whole frame
+    static void deflateFixed(const std::vector<unsigned char>& data, std::vector<unsigned char>& out) {
+        const int WINDOW_SIZE = 32768;
+        const int HASH_SIZE = 1 << 15;
+        const int MAX_CHAIN = 32;
+        const int MIN_MATCH = 3;
+        const int MAX_MATCH = 258;
+
+        BitWriter bits(out);
+        //BFINAL, BTYPE 01
+        bits.write(1, 1);
+        bits.write(1, 2);
+
+        std::vector<int> head(HASH_SIZE, -1);
+        std::vector<int> previous(WINDOW_SIZE, -1);
+        int size = (int)data.size();
+        int position = 0;
+        while (position < size) {
+            int bestLength = 0;
+            int bestDistance = 0;
+            if (position + MIN_MATCH <= size) {
+                int hash = ((data[position] << 10) ^ (data[position + 1] << 5) ^ data[position + 2]) & (HASH_SIZE - 1);
+                int maxLength = size - position < MAX_MATCH ? size - position : MAX_MATCH;
+                int candidate = head[hash];
+                for (int chain = 0; chain < MAX_CHAIN && candidate >= 0 && position - candidate <= WINDOW_SIZE; chain++) {
+                    if (data[candidate + bestLength] == data[position + bestLength]) {
+                        int length = 0;
+                        while (length < maxLength && data[candidate + length] == data[position + length]) {
+                            length++;
+                        }
+                        if (length > bestLength) {
+                            bestLength = length;
+                            bestDistance = position - candidate;
+                            if (length == maxLength) {
+                                break;
+                            }
+                        }
+                    }
+                    candidate = previous[candidate & (WINDOW_SIZE - 1)];
+                }
+                previous[position & (WINDOW_SIZE - 1)] = head[hash];
+                head[hash] = position;
+            }
+
+            if (bestLength >= MIN_MATCH) {
+                writeMatch(bits, bestLength, bestDistance);
+                //the skipped positions still go into the chains
+                for (int i = 1; i < bestLength; i++) {
+                    int next = position + i;
+                    if (next + MIN_MATCH <= size) {
+                        int hash = ((data[next] << 10) ^ (data[next + 1] << 5) ^ data[next + 2]) & (HASH_SIZE - 1);
+                        previous[next & (WINDOW_SIZE - 1)] = head[hash];
+                        head[hash] = next;
+                    }
+                }
+                position += bestLength;
+            }
+            else {
+                writeFixedSymbol(bits, data[position]);
+                position++;
+            }
+        }
+        writeFixedSymbol(bits, 256);
+        bits.flush();
+    }
+
+    static unsigned char paethPredictor(int a, int b, int c) {
+        int p = a + b - c;
+        int pa = p > a ? p - a : a - p;
+        int pb = p > b ? p - b : b - p;
+        int pc = p > c ? p - c : c - p;
+        if (pa <= pb && pa <= pc) {
+            return (unsigned char)a;
+        }
+        return (unsigned char)(pb <= pc ? b : c);
+    }
+
+    static std::vector<unsigned char> encodePNG(const std::vector<unsigned char>& rgba, int width, int height) {
+        //RGB rows, the alpha is dropped like in PPM
+        size_t rowSize = (size_t)width * 3;
+        std::vector<unsigned char> rows(rowSize * height);
+        for (size_t i = 0; i < (size_t)width * height; i++) {
+            std::memcpy(&rows[i * 3], &rgba[i * 4], 3);
+        }
+
+        //every row gets the filter with the smallest sum of absolute differences, the usual heuristic
+        std::vector<unsigned char> raw;
+        raw.reserve((rowSize + 1) * height);
+        std::vector<unsigned char> zeroRow(rowSize, 0);
+        std::vector<unsigned char> candidates[5];
+        for (int filter = 0; filter < 5; filter++) {
+            candidates[filter].resize(rowSize);
+        }
+        for (int y = 0; y < height; y++) {
+            const unsigned char* row = &rows[y * rowSize];
+            const unsigned char* above = y > 0 ? &rows[(y - 1) * rowSize] : &zeroRow[0];
+            int bestFilter = 0;
+            unsigned long bestCost = 0;
+            for (int filter = 0; filter < 5; filter++) {
+                unsigned char* filtered = &candidates[filter][0];
+                unsigned long cost = 0;
+                for (size_t x = 0; x < rowSize; x++) {
+                    int left = x >= 3 ? row[x - 3] : 0;
+                    int upperLeft = x >= 3 ? above[x - 3] : 0;
+                    int predicted = 0;
+                    switch (filter) {
+                    case 1:
+                        predicted = left;
+                        break;
+                    case 2:
+                        predicted = above[x];
+                        break;
+                    case 3:
+                        predicted = (left + above[x]) / 2;
+                        break;
+                    case 4:
+                        predicted = paethPredictor(left, above[x], upperLeft);
+                        break;
+                    }
+                    filtered[x] = (unsigned char)(row[x] - predicted);
+                    cost += filtered[x] < 128 ? filtered[x] : 256 - filtered[x];
+                }
+                if (filter == 0 || cost < bestCost) {
+                    bestFilter = filter;
+                    bestCost = cost;
+                }
+            }
+            raw.push_back((unsigned char)bestFilter);
+            raw.insert(raw.end(), candidates[bestFilter].begin(), candidates[bestFilter].end());
+        }
+
+        std::vector<unsigned char> zlib;
+        zlib.reserve(raw.size() / 2 + 16);
+        //deflate with a 32 KB window, fastest compression level
+        zlib.push_back(0x78);
+        zlib.push_back(0x01);
+        deflateFixed(raw, zlib);
+
+        uint32_t a = 1, b = 0;
+        for (size_t i = 0; i < raw.size(); i++) {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        writeBigEndian(zlib, (b << 16) | a);
+
+        std::vector<unsigned char> out = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+        std::vector<unsigned char> header;
+        writeBigEndian(header, (uint32_t)width);
+        writeBigEndian(header, (uint32_t)height);
+        //8 bits per channel, RGB, deflate, adaptive filtering, no interlace
+        header.push_back(8);
+        header.push_back(2);
+        header.push_back(0);
+        header.push_back(0);
+        header.push_back(0);
+        writeChunk(out, "IHDR", header);
+        writeChunk(out, "IDAT", zlib);
+        writeChunk(out, "IEND", std::vector<unsigned char>());
+        return out;
+    }
+
+    //one FRAME record: the Y plane, then Cb and Cr averaged over 2x2 pixels
+    static std::vector<unsigned char> encodeY4MFrame(const std::vector<unsigned char>& rgba, int width, int height) {
+        int chromaWidth = (width + 1) / 2;
+        int chromaHeight = (height + 1) / 2;
+        const char marker[] = "FRAME\n";
+        size_t markerSize = sizeof(marker) - 1;
+        size_t lumaSize = (size_t)width * height;
+        size_t chromaSize = (size_t)chromaWidth * chromaHeight;
+        std::vector<unsigned char> out(markerSize + lumaSize + 2 * chromaSize);
+        std::memcpy(&out[0], marker, markerSize);
+        unsigned char* luma = &out[markerSize];
+        unsigned char* cb = luma + lumaSize;
+        unsigned char* cr = cb + chromaSize;
+
+        for (size_t i = 0; i < lumaSize; i++) {
+            const unsigned char* p = &rgba[4 * i];
+            luma[i] = (unsigned char)(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2] + 0.5f);
+        }
+        for (int y = 0; y < chromaHeight; y++) {
+            for (int x = 0; x < chromaWidth; x++) {
+                float r = 0.0f, g = 0.0f, b = 0.0f;
+                int samples = 0;
+                for (int dy = 0; dy < 2 && 2 * y + dy < height; dy++) {
+                    for (int dx = 0; dx < 2 && 2 * x + dx < width; dx++) {
+                        const unsigned char* p = &rgba[4 * ((size_t)(2 * y + dy) * width + 2 * x + dx)];
+                        r += p[0];
+                        g += p[1];
+                        b += p[2];
+                        samples++;
+                    }
+                }
+                r /= samples;
+                g /= samples;
+                b /= samples;
+                size_t i = (size_t)y * chromaWidth + x;
+                cb[i] = (unsigned char)(128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b + 0.5f);
+                cr[i] = (unsigned char)(128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b + 0.5f);
+            }
+        }
+        return out;
+    }
+
+    std::string getY4MHeader(int width, int height, int frameRate) {
+        return "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) +
+            " F" + std::to_string(frameRate) + ":1 Ip A1:1 C420jpeg\n";
+    }
+
+    std::vector<unsigned char> encodeImage(const std::vector<unsigned char>& rgba, int width, int height, ImageFormat format) {
+        switch (format) {
+        case IMAGE_QOI:
+            return encodeQOI(rgba, width, height);
+        case IMAGE_PNG:
+            return encodePNG(rgba, width, height);
+        case IMAGE_Y4M:
+            return encodeY4MFrame(rgba, width, height);
+        default:
+            return encodePPM(rgba, width, height);
+        }
+    }
+
+    std::string getImageExtension(ImageFormat format) {
+        switch (format) {
+        case IMAGE_QOI:
+            return ".qoi";
+        case IMAGE_PNG:
+            return ".png";
+        case IMAGE_Y4M:
+            return ".y4m";
+        default:
+            return ".ppm";
+        }
+    }
+
+    bool parseImageFormat(std::string name, ImageFormat& format) {
+        if (name == "ppm") {
+            format = IMAGE_PPM;
+        }
+        else if (name == "qoi") {
+            format = IMAGE_QOI;
+        }
+        else if (name == "png") {
+            format = IMAGE_PNG;
+        }
+        else if (name == "y4m") {
+            format = IMAGE_Y4M;
+        }
+        else {
+            return false;
+        }
+        return true;
+    }
+}
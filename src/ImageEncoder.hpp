@@ -0,0 +1,30 @@
+#ifndef ImageEncoder_hpp
+#define ImageEncoder_hpp
+
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    enum ImageFormat {
+        //binary PPM, the raw RGB bytes behind a short header
+        IMAGE_PPM,
+        IMAGE_QOI,
+        //filtered rows compressed with LZ77 and the fixed deflate Huffman codes
+        IMAGE_PNG,
+        //YUV4MPEG2 video, every image is one frame of a single stream
+        IMAGE_Y4M
+    };
+
+    //rgba - 8 bit RGBA pixels, top row first
+    std::vector<unsigned char> encodeImage(const std::vector<unsigned char>& rgba, int width, int height, ImageFormat format);
+    //YUV4MPEG2 stream header, 4:2:0 chroma with full range BT.601 like JPEG
+    std::string getY4MHeader(int width, int height, int frameRate);
+    //file extension with the dot
+    std::string getImageExtension(ImageFormat format);
+    //"ppm", "qoi", "png" or "y4m", false for anything else
+    bool parseImageFormat(std::string name, ImageFormat& format);
+
+}
+
+#endif /* ImageEncoder_hpp */
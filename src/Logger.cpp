@@ -0,0 +1,145 @@
+#include "Logger.hpp"
+
+#include <cstdarg>
+
+namespace gps {
+
+    //how long the writer sleeps when the queue is empty
+    static const int LOG_POLL_MILLISECONDS = 2;
+
+    static const char* getLevelName(LogLevel level) {
+        switch (level) {
+        case LOG_LEVEL_TRACE:
+            return "trace";
+        case LOG_LEVEL_DEBUG:
+            return "debug";
+        case LOG_LEVEL_WARNING:
+            return "warning";
+        case LOG_LEVEL_ERROR:
+            return "error";
+        default:
+            return "info";
+        }
+    }
+
+    Logger& Logger::get() {
+        static Logger logger;
+        return logger;
+    }
+
+    Logger::Logger() {
+        this->queue.Init(LOG_QUEUE_SIZE);
+        this->level = LOG_LEVEL_INFO;
+        this->queuedMessages = 0;
+        this->writtenMessages = 0;
+        this->droppedMessages = 0;
+        this->stopping = false;
+        this->start = std::chrono::steady_clock::now();
+        this->writer = std::thread(&Logger::writerLoop, this);
+    }
+
+    //the static instance goes away at exit, after everything that could still log
+    Logger::~Logger() {
+        this->stopping = true;
+        this->writer.join();
+        int dropped = this->droppedMessages;
+        if (dropped > 0) {
+            std::fprintf(stderr, "%d log messages dropped, the queue was full\n", dropped);
+        }
+    }
+
+    void Logger::setLevel(LogLevel level) {
+        this->level = level;
+    }
+
+    LogLevel Logger::getLevel() {
+        return (LogLevel)this->level.load();
+    }
+
+    bool Logger::isEnabled(LogLevel level) {
+        return level >= this->level.load(std::memory_order_relaxed);
+    }
+
+    void Logger::Write(LogLevel level, const char* format, ...) {
+        Message message;
+        message.level = level;
+        message.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->start).count();
+        va_list arguments;
+        va_start(arguments, format);
+        std::vsnprintf(message.text, sizeof(message.text), format, arguments);
+        va_end(arguments);
+
+        //warnings and errors are rare and worth the wait for a free cell
+        while (!this->queue.TryPush(message)) {
+            if (level < LOG_LEVEL_WARNING) {
+                this->droppedMessages++;
+                return;
+            }
+            std::this_thread::yield();
+        }
+        this->queuedMessages++;
+    }
+
+    void Logger::Flush() {
+        int queued = this->queuedMessages;
+        while (this->writtenMessages < queued) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    int Logger::getDroppedMessages() {
+        return this->droppedMessages;
+    }
+
+    void Logger::writerLoop() {
+        Message message;
+        for (;;) {
+            //read before the drain, so the pass that sees the flag still prints everything written before it
+            bool stop = this->stopping;
+            bool wrote = false;
+            while (this->queue.TryPop(message)) {
+                this->print(message);
+                this->writtenMessages++;
+                wrote = true;
+            }
+            if (wrote) {
+                std::fflush(stdout);
+                std::fflush(stderr);
+            }
+            if (stop) {
+                return;
+            }
+            if (!wrote) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(LOG_POLL_MILLISECONDS));
+            }
+        }
+    }
+
+    void Logger::print(const Message& message) {
+        //stdout is already stderr when it carries the Y4M stream, see FrameCapture::ReserveStdout
+        FILE* stream = message.level >= LOG_LEVEL_WARNING ? stderr : stdout;
+        std::fprintf(stream, "[%9.3f %s] %s\n", message.seconds, getLevelName(message.level), message.text);
+    }
+
+    bool parseLogLevel(std::string name, LogLevel& level) {
+        if (name == "trace") {
+            level = LOG_LEVEL_TRACE;
+        }
+        else if (name == "debug") {
+            level = LOG_LEVEL_DEBUG;
+        }
+        else if (name == "info") {
+            level = LOG_LEVEL_INFO;
+        }
+        else if (name == "warning") {
+            level = LOG_LEVEL_WARNING;
+        }
+        else if (name == "error") {
+            level = LOG_LEVEL_ERROR;
+        }
+        else {
+            return false;
+        }
+        return true;
+    }
+}
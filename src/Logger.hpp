@@ -0,0 +1,115 @@
+#ifndef Logger_hpp
+#define Logger_hpp
+
+#include "BoundedQueue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+//lowest level compiled in, the calls below it are removed by the preprocessor:
+//0 trace, 1 debug, 2 info, 3 warning, 4 error
+#ifndef GPS_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define GPS_LOG_MIN_LEVEL 2
+#else
+#define GPS_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+namespace gps {
+
+    enum LogLevel {
+        LOG_LEVEL_TRACE,
+        LOG_LEVEL_DEBUG,
+        LOG_LEVEL_INFO,
+        LOG_LEVEL_WARNING,
+        LOG_LEVEL_ERROR
+    };
+
+    //messages waiting for the writer thread, a full queue drops trace to info messages instead of blocking
+    const int LOG_QUEUE_SIZE = 512;
+    //longer messages are cut
+    const int LOG_MESSAGE_SIZE = 1024;
+
+    //printf style messages formatted on the calling thread into a lock-free ring,
+    //a background thread does all the console writes
+    class Logger
+    {
+    public:
+        static Logger& get();
+
+        //messages below level are dropped at run time
+        void setLevel(LogLevel level);
+        LogLevel getLevel();
+        bool isEnabled(LogLevel level);
+        void Write(LogLevel level, const char* format, ...);
+        //blocks until every message written so far is on the console
+        void Flush();
+
+        int getDroppedMessages();
+
+        ~Logger();
+
+    private:
+        struct Message {
+            LogLevel level;
+            double seconds;
+            char text[LOG_MESSAGE_SIZE];
+        };
+
+        BoundedQueue<Message> queue;
+        std::atomic<int> level;
+        std::atomic<int> queuedMessages;
+        std::atomic<int> writtenMessages;
+        std::atomic<int> droppedMessages;
+        std::atomic<bool> stopping;
+        std::chrono::steady_clock::time_point start;
+        std::thread writer;
+
+        Logger();
+        void writerLoop();
+        void print(const Message& message);
+    };
+
+    //"trace", "debug", "info", "warning" or "error", false for anything else
+    bool parseLogLevel(std::string name, LogLevel& level);
+
+}
+
+//the arguments are only evaluated when the level is enabled
+#define GPS_LOG(level, ...) \
+    do { \
+        if (gps::Logger::get().isEnabled(level)) \
+            gps::Logger::get().Write(level, __VA_ARGS__); \
+    } while (0)
+
+#if GPS_LOG_MIN_LEVEL <= 0
+#define GPS_LOG_TRACE(...) GPS_LOG(gps::LOG_LEVEL_TRACE, __VA_ARGS__)
+#else
+#define GPS_LOG_TRACE(...) ((void)0)
+#endif
+
+#if GPS_LOG_MIN_LEVEL <= 1
+#define GPS_LOG_DEBUG(...) GPS_LOG(gps::LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define GPS_LOG_DEBUG(...) ((void)0)
+#endif
+
+#if GPS_LOG_MIN_LEVEL <= 2
+#define GPS_LOG_INFO(...) GPS_LOG(gps::LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define GPS_LOG_INFO(...) ((void)0)
+#endif
+
+#if GPS_LOG_MIN_LEVEL <= 3
+#define GPS_LOG_WARNING(...) GPS_LOG(gps::LOG_LEVEL_WARNING, __VA_ARGS__)
+#else
+#define GPS_LOG_WARNING(...) ((void)0)
+#endif
+
+#define GPS_LOG_ERROR(...) GPS_LOG(gps::LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#endif /* Logger_hpp */
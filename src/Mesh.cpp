@@ -8,6 +8,17 @@ namespace gps {
 		this->indices = indices;
 		this->textures = textures;
 
+		this->bounds.min = glm::vec3(0.0f);
+		this->bounds.max = glm::vec3(0.0f);
+		for (size_t i = 0; i < this->vertices.size(); i++) {
+			if (i == 0) {
+				this->bounds.min = this->vertices[i].Position;
+				this->bounds.max = this->vertices[i].Position;
+			}
+			this->bounds.min = glm::min(this->bounds.min, this->vertices[i].Position);
+			this->bounds.max = glm::max(this->bounds.max, this->vertices[i].Position);
+		}
+
 		this->setupMesh();
 	}
 
@@ -15,30 +26,79 @@ namespace gps {
 	    return this->buffers;
 	}
 
+	BoundingBox Mesh::getBoundingBox() {
+		return this->bounds;
+	}
+
+	BoundingBox transformBoundingBox(BoundingBox box, glm::mat4 transform) {
+		BoundingBox result;
+		for (int i = 0; i < 8; i++) {
+			glm::vec3 corner(
+				(i & 1) ? box.max.x : box.min.x,
+				(i & 2) ? box.max.y : box.min.y,
+				(i & 4) ? box.max.z : box.min.z);
+			glm::vec3 transformed = glm::vec3(transform * glm::vec4(corner, 1.0f));
+			if (i == 0) {
+				result.min = transformed;
+				result.max = transformed;
+			}
+			result.min = glm::min(result.min, transformed);
+			result.max = glm::max(result.max, transformed);
+		}
+		return result;
+	}
+
+	BoundingBox mergeBoundingBoxes(BoundingBox first, BoundingBox second) {
+		BoundingBox result;
+		result.min = glm::min(first.min, second.min);
+		result.max = glm::max(first.max, second.max);
+		return result;
+	}
+
+	bool isOutsideFrustum(BoundingBox box, glm::mat4 viewProjection) {
+		//corners outside each of the planes -x, +x, -y, +y, -z, +z
+		int outside[6] = { 0, 0, 0, 0, 0, 0 };
+		for (int i = 0; i < 8; i++) {
+			glm::vec4 corner = viewProjection * glm::vec4(
+				(i & 1) ? box.max.x : box.min.x,
+				(i & 2) ? box.max.y : box.min.y,
+				(i & 4) ? box.max.z : box.min.z,
+				1.0f);
+			for (int axis = 0; axis < 3; axis++) {
+				if (corner[axis] < -corner.w)
+					outside[2 * axis]++;
+				if (corner[axis] > corner.w)
+					outside[2 * axis + 1]++;
+			}
+		}
+		for (int plane = 0; plane < 6; plane++) {
+			if (outside[plane] == 8)
+				return true;
+		}
+		return false;
+	}
+
 	/* Mesh drawing function - also applies associated textures */
-	void Mesh::Draw(gps::Shader shader)
+	void Mesh::Draw(gps::Shader& shader)
 	{
+		gps::GLStateCache& state = gps::GLStateCache::get();
 		shader.useShaderProgram();
 
 		//set textures
 		for (GLuint i = 0; i < textures.size(); i++)
 		{
-			glActiveTexture(GL_TEXTURE0 + i);
-			glUniform1i(glGetUniformLocation(shader.shaderProgram, this->textures[i].type.c_str()), i);
-			glBindTexture(GL_TEXTURE_2D, this->textures[i].id);
+			glUniform1i(shader.getUniformLocation(this->textures[i].type), i);
+			state.BindTexture(i, GL_TEXTURE_2D, this->textures[i].id);
+		}
+		//empty the units left over from a mesh with more textures, nothing is unbound after a draw
+		for (int i = textures.size(); i < MAX_MESH_TEXTURES; i++)
+		{
+			state.BindTexture(i, GL_TEXTURE_2D, 0);
 		}
 
-		glBindVertexArray(this->buffers.VAO);
-		glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-
-        for(GLuint i = 0; i < this->textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i);
-            glBindTexture(GL_TEXTURE_2D, 0);
-        }
-
-    }
+		state.BindVertexArray(this->buffers.VAO);
+		state.DrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
+	}
 
 	// Initializes all the buffer objects/arrays
 	void Mesh::setupMesh(){
@@ -47,7 +107,7 @@ namespace gps {
 		glGenBuffers(1, &this->buffers.VBO);
 		glGenBuffers(1, &this->buffers.EBO);
 
-		glBindVertexArray(this->buffers.VAO);
+		gps::GLStateCache::get().BindVertexArray(this->buffers.VAO);
 		// Load data into vertex buffers
 		glBindBuffer(GL_ARRAY_BUFFER, this->buffers.VBO);
 		glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(Vertex), &this->vertices[0], GL_STATIC_DRAW);
@@ -66,6 +126,6 @@ namespace gps {
 		glEnableVertexAttribArray(2);
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
 
-		glBindVertexArray(0);
+		gps::GLStateCache::get().BindVertexArray(0);
 	}
 }
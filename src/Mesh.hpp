@@ -5,6 +5,7 @@
 #include "glm/glm.hpp"
 
 #include "Shader.hpp"
+#include "GLStateCache.hpp"
 
 #include <string>
 #include <vector>
@@ -34,6 +35,22 @@ struct Material
         glm::vec3 specular;
     };
 
+struct BoundingBox
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Returns the axis aligned box enclosing the given box after it is transformed by the matrix
+BoundingBox transformBoundingBox(BoundingBox box, glm::mat4 transform);
+// Returns the smallest box enclosing both boxes
+BoundingBox mergeBoundingBoxes(BoundingBox first, BoundingBox second);
+// Returns true if the box lies entirely outside one of the clip planes of the view projection matrix
+bool isOutsideFrustum(BoundingBox box, glm::mat4 viewProjection);
+
+// ambient, diffuse and specular, bound to the first texture units
+const int MAX_MESH_TEXTURES = 3;
+
 struct Buffers {
     GLuint VAO;
     GLuint VBO;
@@ -51,11 +68,15 @@ public:
 
 	Buffers getBuffers();
 
-	void Draw(gps::Shader shader);
+	BoundingBox getBoundingBox();
+
+	void Draw(gps::Shader& shader);
 
 private:
     /*  Render data  */
     Buffers buffers;
+    // Object space bounds of the vertices
+    BoundingBox bounds;
 
 	// Initializes all the buffer objects/arrays
 	void setupMesh();
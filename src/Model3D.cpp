@@ -1,4 +1,6 @@
 #include "Model3D.hpp"
+#include "GLStateCache.hpp"
+#include "Logger.hpp"
 
 namespace gps {
 
@@ -14,16 +16,57 @@ namespace gps {
 	}
 
 	// Draw each mesh from the model
-	void Model3D::Draw(gps::Shader shaderProgram)
+	void Model3D::Draw(gps::Shader& shaderProgram)
 	{
 		for (int i = 0; i < meshes.size(); i++)
 			meshes[i].Draw(shaderProgram);
 	}
 
+	int Model3D::getMeshCount()
+	{
+		return (int)meshes.size();
+	}
+
+	gps::BoundingBox Model3D::getMeshBoundingBox(int mesh)
+	{
+		return meshes[mesh].getBoundingBox();
+	}
+
+	void Model3D::DrawMesh(int mesh, gps::Shader& shaderProgram)
+	{
+		meshes[mesh].Draw(shaderProgram);
+	}
+
+	int Model3D::getMeshTriangleCount(int mesh)
+	{
+		return (int)meshes[mesh].indices.size() / 3;
+	}
+
+	GLuint Model3D::getMeshMaterial(int mesh)
+	{
+		//the textures are shared between the meshes of a model, so the first one identifies the set
+		if (meshes[mesh].textures.empty()) {
+			return 0;
+		}
+		return meshes[mesh].textures[0].id;
+	}
+
+	gps::BoundingBox Model3D::getBoundingBox()
+	{
+		gps::BoundingBox bounds = { glm::vec3(0.0f), glm::vec3(0.0f) };
+		for (size_t i = 0; i < meshes.size(); i++) {
+			if (i == 0)
+				bounds = meshes[i].getBoundingBox();
+			else
+				bounds = gps::mergeBoundingBoxes(bounds, meshes[i].getBoundingBox());
+		}
+		return bounds;
+	}
+
 	// Does the parsing of the .obj file and fills in the data structure
 	void Model3D::ReadOBJ(std::string fileName, std::string basePath){
 
-        std::cout << "Loading : " << fileName << std::endl;
+        GPS_LOG_INFO("Loading : %s", fileName.c_str());
 		tinyobj::attrib_t attrib;
 		std::vector<tinyobj::shape_t> shapes;
 		std::vector<tinyobj::material_t> materials;
@@ -33,15 +76,15 @@ namespace gps {
 		bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, fileName.c_str(), basePath.c_str(), GL_TRUE);
 
 		if (!err.empty()) { // `err` may contain warning message.
-			std::cerr << err << std::endl;
+			GPS_LOG_WARNING("%s", err.c_str());
 		}
 
 		if (!ret) {
 			exit(1);
 		}
 
-		std::cout << "# of shapes    : " << shapes.size() << std::endl;
-		std::cout << "# of materials : " << materials.size() << std::endl;
+		GPS_LOG_INFO("# of shapes    : %d", (int)shapes.size());
+		GPS_LOG_INFO("# of materials : %d", (int)materials.size());
 
 		// Loop over shapes
 		for (size_t s = 0; s < shapes.size(); s++) {
@@ -163,14 +206,12 @@ namespace gps {
 		int force_channels = 4;
 		unsigned char* image_data = stbi_load(file_name, &x, &y, &n, force_channels);
 		if (!image_data) {
-			fprintf(stderr, "ERROR: could not load %s\n", file_name);
+			GPS_LOG_ERROR("could not load %s", file_name);
 			return false;
 		}
 		// NPOT check
 		if ((x & (x - 1)) != 0 || (y & (y - 1)) != 0) {
-			fprintf(
-				stderr, "WARNING: texture %s is not power-of-2 dimensions\n", file_name
-			);
+			GPS_LOG_WARNING("texture %s is not power-of-2 dimensions", file_name);
 		}
 
 		int width_in_bytes = x * 4;
@@ -193,7 +234,7 @@ namespace gps {
 
 		GLuint textureID;
 		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		gps::GLStateCache::get().BindTexture(0, GL_TEXTURE_2D, textureID);
 		glTexImage2D(
 			GL_TEXTURE_2D,
 			0,
@@ -211,13 +252,13 @@ namespace gps {
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glBindTexture(GL_TEXTURE_2D, 0);
 
 		return textureID;
 	}
 
 	Model3D::~Model3D() {
         for (size_t i = 0; i < loadedTextures.size(); i++) {
+            GLStateCache::get().ForgetTexture(loadedTextures.at(i).id);
             glDeleteTextures(1, &loadedTextures.at(i).id);
         }
 
@@ -22,7 +22,23 @@ namespace gps {
 
 		void LoadModel(std::string fileName, std::string basePath);
 
-		void Draw(gps::Shader shaderProgram);
+		void Draw(gps::Shader& shaderProgram);
+
+		// Object space bounds of all the component meshes
+		gps::BoundingBox getBoundingBox();
+
+		int getMeshCount();
+
+		gps::BoundingBox getMeshBoundingBox(int mesh);
+
+		// Draw a single component mesh
+		void DrawMesh(int mesh, gps::Shader& shaderProgram);
+
+		// Number of triangles in a single component mesh
+		int getMeshTriangleCount(int mesh);
+
+		// Texture set of a single component mesh, meshes with the same textures return the same value
+		GLuint getMeshMaterial(int mesh);
 
     private:
 		// Component meshes - group of objects
@@ -0,0 +1,44 @@
+#include "OffscreenTarget.hpp"
+#include "Logger.hpp"
+
+namespace gps {
+
+    void OffscreenTarget::Init(int width, int height) {
+        this->width = width;
+        this->height = height;
+
+        glGenRenderbuffers(1, &this->colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, this->colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_SRGB8_ALPHA8, width, height);
+        glGenRenderbuffers(1, &this->depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, this->depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &this->framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            GPS_LOG_ERROR("Offscreen framebuffer is incomplete");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void OffscreenTarget::Delete() {
+        glDeleteFramebuffers(1, &this->framebuffer);
+        glDeleteRenderbuffers(1, &this->colorBuffer);
+        glDeleteRenderbuffers(1, &this->depthBuffer);
+    }
+
+    GLuint OffscreenTarget::getFramebuffer() {
+        return this->framebuffer;
+    }
+
+    int OffscreenTarget::getWidth() {
+        return this->width;
+    }
+
+    int OffscreenTarget::getHeight() {
+        return this->height;
+    }
+}
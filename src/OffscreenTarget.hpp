@@ -0,0 +1,30 @@
+#ifndef OffscreenTarget_hpp
+#define OffscreenTarget_hpp
+
+#include <GL/glew.h>
+
+namespace gps {
+
+    //color and depth renderbuffers the final passes draw into when there is no visible window
+    class OffscreenTarget
+    {
+    public:
+        //sRGB color like the window, so GL_FRAMEBUFFER_SRGB does the same work
+        void Init(int width, int height);
+        void Delete();
+
+        GLuint getFramebuffer();
+        int getWidth();
+        int getHeight();
+
+    private:
+        GLuint framebuffer;
+        GLuint colorBuffer;
+        GLuint depthBuffer;
+        int width;
+        int height;
+    };
+
+}
+
+#endif /* OffscreenTarget_hpp */
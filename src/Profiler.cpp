@@ -0,0 +1,225 @@
+#include "Profiler.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+namespace gps {
+
+    Profiler& Profiler::get() {
+        //one per process, the queries belong to the single context
+        static Profiler profiler;
+        return profiler;
+    }
+
+    Profiler::Profiler() {
+        this->epoch = std::chrono::steady_clock::now();
+    }
+
+    double Profiler::now() {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - this->epoch;
+        return elapsed.count();
+    }
+
+    GLuint Profiler::acquireQuery() {
+        if (this->freeQueries.empty()) {
+            GLuint query;
+            glGenQueries(1, &query);
+            return query;
+        }
+        GLuint query = this->freeQueries.back();
+        this->freeQueries.pop_back();
+        return query;
+    }
+
+    void Profiler::BeginFrame() {
+        FrameSlot& slot = this->slots[this->frame % PROFILER_FRAME_LATENCY];
+        this->resolve(slot);
+        slot.frame = this->frame;
+        this->openScopes.clear();
+    }
+
+    void Profiler::EndFrame() {
+        while (!this->openScopes.empty()) {
+            this->EndScope();
+        }
+        this->frame++;
+    }
+
+    void Profiler::BeginScope(std::string name) {
+        FrameSlot& slot = this->slots[this->frame % PROFILER_FRAME_LATENCY];
+
+        Scope scope;
+        scope.name = name;
+        scope.depth = (int)this->openScopes.size();
+        scope.cpuStart = this->now();
+        scope.cpuEnd = scope.cpuStart;
+        scope.startQuery = this->acquireQuery();
+        scope.endQuery = this->acquireQuery();
+        glQueryCounter(scope.startQuery, GL_TIMESTAMP);
+
+        this->openScopes.push_back((int)slot.scopes.size());
+        slot.scopes.push_back(scope);
+    }
+
+    void Profiler::EndScope() {
+        if (this->openScopes.empty()) {
+            return;
+        }
+        FrameSlot& slot = this->slots[this->frame % PROFILER_FRAME_LATENCY];
+        Scope& scope = slot.scopes[this->openScopes.back()];
+        this->openScopes.pop_back();
+
+        glQueryCounter(scope.endQuery, GL_TIMESTAMP);
+        scope.cpuEnd = this->now();
+    }
+
+    void Profiler::resolve(FrameSlot& slot) {
+        if (slot.frame < 0) {
+            return;
+        }
+
+        //the last timestamp of the frame lands last
+        bool available = true;
+        if (!slot.scopes.empty()) {
+            GLuint result = GL_FALSE;
+            glGetQueryObjectuiv(slot.scopes.back().endQuery, GL_QUERY_RESULT_AVAILABLE, &result);
+            available = result == GL_TRUE;
+        }
+        if (!available) {
+            this->droppedFrames++;
+        }
+
+        bool traced = slot.frame >= this->traceFirstFrame && slot.frame <= this->traceLastFrame;
+        for (Scope& scope : slot.scopes) {
+            std::map<std::string, History>::iterator found = this->history.find(scope.name);
+            if (found == this->history.end()) {
+                History entry = History();
+                entry.order = (int)this->history.size();
+                entry.depth = scope.depth;
+                found = this->history.insert(std::make_pair(scope.name, entry)).first;
+            }
+            History& entry = found->second;
+
+            //-1 - no GPU time for this frame, left out of the averages
+            double gpuTime = -1.0;
+            if (available) {
+                GLuint64 start, end;
+                glGetQueryObjectui64v(scope.startQuery, GL_QUERY_RESULT, &start);
+                glGetQueryObjectui64v(scope.endQuery, GL_QUERY_RESULT, &end);
+                gpuTime = (end - start) * 1e-6;
+
+                if (!this->gpuEpochSet) {
+                    this->gpuEpochSet = true;
+                    this->gpuEpoch = start;
+                    this->gpuEpochCpuTime = scope.cpuStart;
+                }
+                if (traced) {
+                    double gpuStart = this->gpuEpochCpuTime + (double)(GLint64)(start - this->gpuEpoch) * 1e-6;
+                    this->traceEvents.push_back({ scope.name, 1, gpuStart * 1000.0, gpuTime * 1000.0 });
+                }
+            }
+            if (traced) {
+                this->traceEvents.push_back({ scope.name, 0, scope.cpuStart * 1000.0, (scope.cpuEnd - scope.cpuStart) * 1000.0 });
+            }
+
+            entry.cpu[entry.next] = scope.cpuEnd - scope.cpuStart;
+            entry.gpu[entry.next] = gpuTime;
+            entry.next = (entry.next + 1) % PROFILER_HISTORY;
+            entry.count = std::min(entry.count + 1, PROFILER_HISTORY);
+
+            this->freeQueries.push_back(scope.startQuery);
+            this->freeQueries.push_back(scope.endQuery);
+        }
+
+        if (traced && slot.frame == this->traceLastFrame) {
+            this->writeTrace();
+        }
+
+        slot.frame = -1;
+        slot.scopes.clear();
+    }
+
+    void Profiler::CaptureTrace(int frameCount, std::string path) {
+        this->traceEvents.clear();
+        this->traceFirstFrame = this->frame;
+        this->traceLastFrame = this->frame + frameCount - 1;
+        this->tracePath = path;
+    }
+
+    void Profiler::writeTrace() {
+        std::ofstream file(this->tracePath);
+        file << "{ \"traceEvents\": [\n";
+        file << "  { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": { \"name\": \"CPU\" } },\n";
+        file << "  { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": { \"name\": \"GPU\" } }";
+        for (TraceEvent& event : this->traceEvents) {
+            file << ",\n  { \"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.track
+                << ", \"ts\": " << event.start << ", \"dur\": " << event.duration << " }";
+        }
+        file << "\n], \"displayTimeUnit\": \"ms\" }\n";
+
+        GPS_LOG_INFO("Trace of %d frames written to %s", this->traceLastFrame - this->traceFirstFrame + 1, this->tracePath.c_str());
+        this->traceEvents.clear();
+        this->traceFirstFrame = -1;
+        this->traceLastFrame = -1;
+    }
+
+    std::vector<ProfilerScopeStats> Profiler::getStats() {
+        std::vector<std::pair<int, ProfilerScopeStats>> ordered;
+        for (std::map<std::string, History>::iterator it = this->history.begin(); it != this->history.end(); ++it) {
+            History& entry = it->second;
+            ProfilerScopeStats scope;
+            scope.name = it->first;
+            scope.depth = entry.depth;
+            int gpuCount = 0;
+            for (int i = 0; i < entry.count; i++) {
+                scope.cpuAverage += entry.cpu[i];
+                scope.cpuMax = std::max(scope.cpuMax, entry.cpu[i]);
+                if (entry.gpu[i] >= 0.0) {
+                    scope.gpuAverage += entry.gpu[i];
+                    scope.gpuMax = std::max(scope.gpuMax, entry.gpu[i]);
+                    gpuCount++;
+                }
+            }
+            scope.cpuAverage /= std::max(entry.count, 1);
+            scope.gpuAverage /= std::max(gpuCount, 1);
+            ordered.push_back(std::make_pair(entry.order, scope));
+        }
+
+        //first seen first, which follows the frame for a stable set of scopes
+        std::sort(ordered.begin(), ordered.end(),
+            [](const std::pair<int, ProfilerScopeStats>& a, const std::pair<int, ProfilerScopeStats>& b) { return a.first < b.first; });
+        std::vector<ProfilerScopeStats> stats;
+        for (std::pair<int, ProfilerScopeStats>& entry : ordered) {
+            stats.push_back(entry.second);
+        }
+        return stats;
+    }
+
+    int Profiler::getDroppedFrames() {
+        return this->droppedFrames;
+    }
+
+    void Profiler::Delete() {
+        for (FrameSlot& slot : this->slots) {
+            for (Scope& scope : slot.scopes) {
+                this->freeQueries.push_back(scope.startQuery);
+                this->freeQueries.push_back(scope.endQuery);
+            }
+            slot.scopes.clear();
+            slot.frame = -1;
+        }
+        if (!this->freeQueries.empty()) {
+            glDeleteQueries((GLsizei)this->freeQueries.size(), &this->freeQueries[0]);
+        }
+        this->freeQueries.clear();
+    }
+
+    ProfileScope::ProfileScope(std::string name) {
+        Profiler::get().BeginScope(name);
+    }
+
+    ProfileScope::~ProfileScope() {
+        Profiler::get().EndScope();
+    }
+}
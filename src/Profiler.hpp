@@ -0,0 +1,118 @@
+#ifndef Profiler_hpp
+#define Profiler_hpp
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    //frames a GPU timestamp has to land before it is read, so reading it never stalls
+    const int PROFILER_FRAME_LATENCY = 4;
+    //frames the rolling statistics are computed over
+    const int PROFILER_HISTORY = 120;
+
+    struct ProfilerScopeStats {
+        std::string name;
+        //nesting level, 0 for the top scopes of a frame
+        int depth = 0;
+        double cpuAverage = 0.0;
+        double cpuMax = 0.0;
+        double gpuAverage = 0.0;
+        double gpuMax = 0.0;
+    };
+
+    //CPU and GPU time of named scopes, the GPU side uses GL_TIMESTAMP queries
+    //read back PROFILER_FRAME_LATENCY frames later; frames still in flight by then are dropped
+    class Profiler
+    {
+    public:
+        static Profiler& get();
+
+        void BeginFrame();
+        void EndFrame();
+        //scopes nest, every BeginScope needs its EndScope in the same frame
+        void BeginScope(std::string name);
+        void EndScope();
+        //record the next frameCount frames and write them as a Chrome trace (chrome://tracing or Perfetto)
+        void CaptureTrace(int frameCount, std::string path);
+        //in the order the scopes were first seen
+        std::vector<ProfilerScopeStats> getStats();
+        int getDroppedFrames();
+        void Delete();
+
+    private:
+        struct Scope {
+            std::string name;
+            int depth;
+            //milliseconds since the profiler started
+            double cpuStart;
+            double cpuEnd;
+            GLuint startQuery;
+            GLuint endQuery;
+        };
+
+        struct FrameSlot {
+            //-1 if the slot holds no frame
+            int frame = -1;
+            std::vector<Scope> scopes;
+        };
+
+        struct History {
+            int order;
+            int depth;
+            double cpu[PROFILER_HISTORY];
+            double gpu[PROFILER_HISTORY];
+            int count;
+            int next;
+        };
+
+        struct TraceEvent {
+            std::string name;
+            //0 - CPU, 1 - GPU
+            int track;
+            //microseconds
+            double start;
+            double duration;
+        };
+
+        FrameSlot slots[PROFILER_FRAME_LATENCY];
+        std::vector<GLuint> freeQueries;
+        //indices of the open scopes in the slot of the current frame
+        std::vector<int> openScopes;
+        int frame = 0;
+        int droppedFrames = 0;
+        std::chrono::steady_clock::time_point epoch;
+        std::map<std::string, History> history;
+
+        std::vector<TraceEvent> traceEvents;
+        int traceFirstFrame = -1;
+        int traceLastFrame = -1;
+        std::string tracePath;
+        //GPU timestamp matched to the CPU clock, the GPU track is drawn relative to it
+        bool gpuEpochSet = false;
+        GLuint64 gpuEpoch = 0;
+        double gpuEpochCpuTime = 0.0;
+
+        Profiler();
+        double now();
+        GLuint acquireQuery();
+        //read the timestamps of the frame in the slot and free its queries
+        void resolve(FrameSlot& slot);
+        void writeTrace();
+    };
+
+    //profiles the enclosing block
+    class ProfileScope
+    {
+    public:
+        ProfileScope(std::string name);
+        ~ProfileScope();
+    };
+
+}
+
+#endif /* Profiler_hpp */
@@ -0,0 +1,144 @@
+#include "RenderQueue.hpp"
+
+#include "glm/gtc/matrix_inverse.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include <algorithm>
+
+namespace gps {
+
+    const int KEY_PASS_SHIFT = 60;
+    const int KEY_TRANSLUCENT_SHIFT = 59;
+    const uint64_t KEY_DEPTH_MAX = (1u << 24) - 1;
+
+    void RenderQueue::Begin(float farPlane) {
+        this->farPlane = farPlane;
+        this->culledItemCount = 0;
+        this->items.clear();
+        this->keys.clear();
+    }
+
+    uint64_t RenderQueue::makeKey(RenderPass pass, bool translucent, GLuint shader, GLuint material, float depth) {
+        uint64_t quantizedDepth = (uint64_t)(glm::clamp(depth / this->farPlane, 0.0f, 1.0f) * KEY_DEPTH_MAX);
+        uint64_t key = ((uint64_t)pass << KEY_PASS_SHIFT) | ((uint64_t)(translucent ? 1 : 0) << KEY_TRANSLUCENT_SHIFT);
+        if (translucent) {
+            //back to front, the depth decides before the state
+            key |= (KEY_DEPTH_MAX - quantizedDepth) << 35;
+            key |= (uint64_t)(shader & 0xFF) << 27;
+            key |= (uint64_t)(material & 0xFFFF) << 11;
+        }
+        else {
+            key |= (uint64_t)(shader & 0xFF) << 51;
+            key |= (uint64_t)(material & 0xFFFF) << 35;
+            key |= quantizedDepth << 11;
+        }
+        return key;
+    }
+
+    void RenderQueue::Submit(RenderPass pass, bool translucent, GLuint material, float depth, RenderItem item) {
+        GLuint shader = item.shader != NULL ? item.shader->shaderProgram : 0;
+        this->keys.push_back(this->makeKey(pass, translucent, shader, material, depth));
+        this->items.push_back(item);
+    }
+
+    void RenderQueue::SubmitModel(RenderPass pass, bool translucent, gps::Model3D& model, glm::mat4 modelMatrix, gps::Shader& shader, glm::mat4 view, glm::mat4 projection) {
+        glm::mat4 viewProjection = projection * view;
+        glm::mat3 normalMatrix = glm::mat3(glm::inverseTranspose(view * modelMatrix));
+        for (int i = 0; i < model.getMeshCount(); i++) {
+            gps::BoundingBox bounds = gps::transformBoundingBox(model.getMeshBoundingBox(i), modelMatrix);
+            if (gps::isOutsideFrustum(bounds, viewProjection)) {
+                this->culledItemCount++;
+                continue;
+            }
+            glm::vec4 center = view * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f);
+
+            RenderItem item;
+            item.shader = &shader;
+            item.model = &model;
+            item.mesh = i;
+            item.modelMatrix = modelMatrix;
+            item.normalMatrix = normalMatrix;
+            this->Submit(pass, translucent, model.getMeshMaterial(i), -center.z, item);
+        }
+    }
+
+    void RenderQueue::Append(RenderQueue& other) {
+        this->keys.insert(this->keys.end(), other.keys.begin(), other.keys.end());
+        this->items.insert(this->items.end(), other.items.begin(), other.items.end());
+        this->culledItemCount += other.culledItemCount;
+        other.keys.clear();
+        other.items.clear();
+        other.culledItemCount = 0;
+    }
+
+    void RenderQueue::Sort() {
+        size_t count = this->keys.size();
+        this->order.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            this->order[i] = (uint32_t)i;
+        }
+        this->sortKeys.resize(count);
+        this->sortOrder.resize(count);
+
+        //least significant digit first, one byte per pass, stable so the lower bytes keep their order
+        for (int shift = 0; shift < 64; shift += 8) {
+            size_t histogram[256] = { 0 };
+            for (size_t i = 0; i < count; i++) {
+                histogram[(this->keys[i] >> shift) & 0xFF]++;
+            }
+            //every key has the same byte, the pass would not move anything
+            if (count == 0 || histogram[(this->keys[0] >> shift) & 0xFF] == count) {
+                continue;
+            }
+
+            size_t offset = 0;
+            for (int bucket = 0; bucket < 256; bucket++) {
+                size_t bucketCount = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += bucketCount;
+            }
+            for (size_t i = 0; i < count; i++) {
+                size_t position = histogram[(this->keys[i] >> shift) & 0xFF]++;
+                this->sortKeys[position] = this->keys[i];
+                this->sortOrder[position] = this->order[i];
+            }
+            this->keys.swap(this->sortKeys);
+            this->order.swap(this->sortOrder);
+        }
+    }
+
+    size_t RenderQueue::findPass(int pass) {
+        return std::lower_bound(this->keys.begin(), this->keys.end(), (uint64_t)pass << KEY_PASS_SHIFT) - this->keys.begin();
+    }
+
+    void RenderQueue::ExecutePass(RenderPass pass) {
+        size_t end = this->findPass(pass + 1);
+        for (size_t i = this->findPass(pass); i < end; i++) {
+            RenderItem& item = this->items[this->order[i]];
+            if (item.customDraw) {
+                item.customDraw();
+                continue;
+            }
+
+            item.shader->useShaderProgram();
+            glUniformMatrix4fv(item.shader->getUniformLocation("model"), 1, GL_FALSE, glm::value_ptr(item.modelMatrix));
+            GLint normalMatrixLoc = item.shader->getUniformLocation("normalMatrix");
+            if (normalMatrixLoc != -1) {
+                glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(item.normalMatrix));
+            }
+            item.model->DrawMesh(item.mesh, *item.shader);
+        }
+    }
+
+    int RenderQueue::getItemCount() {
+        return (int)this->items.size();
+    }
+
+    int RenderQueue::getCulledItemCount() {
+        return this->culledItemCount;
+    }
+
+    int RenderQueue::getPassItemCount(RenderPass pass) {
+        return (int)(this->findPass(pass + 1) - this->findPass(pass));
+    }
+}
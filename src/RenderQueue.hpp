@@ -0,0 +1,81 @@
+#ifndef RenderQueue_hpp
+#define RenderQueue_hpp
+
+#include <GL/glew.h>
+
+#include "glm/glm.hpp"
+
+#include "Model3D.hpp"
+#include "Shader.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace gps {
+
+    //passes run in this order, a pass is the top of the draw key
+    enum RenderPass {
+        RENDER_PASS_DEPTH,
+        RENDER_PASS_GBUFFER,
+        RENDER_PASS_OPAQUE,
+        RENDER_PASS_UNLIT,
+        RENDER_PASS_SKY,
+        RENDER_PASS_TRANSPARENT,
+        RENDER_PASS_COUNT
+    };
+
+    struct RenderItem {
+        gps::Shader* shader;
+        gps::Model3D* model;
+        int mesh;
+        glm::mat4 modelMatrix;
+        //packed when the item is recorded, so the submission only uploads it
+        glm::mat3 normalMatrix;
+        //draws anything that is not a model mesh, e.g. the sky box
+        std::function<void()> customDraw;
+    };
+
+    //draws are submitted in any order and sorted by a 64 bit key:
+    //opaque      pass(4) | translucent(1) | shader(8) | material(16) | depth(24)
+    //translucent pass(4) | translucent(1) | inverted depth(24) | shader(8) | material(16)
+    //so opaque draws are grouped by state then front to back, translucent draws go back to front
+    //recording touches no GL state, so queues can be filled on worker threads and appended together
+    class RenderQueue
+    {
+    public:
+        //empty the queue, depths are quantized over [0, farPlane]
+        void Begin(float farPlane);
+        //depth - view space distance used for the ordering
+        void Submit(RenderPass pass, bool translucent, GLuint material, float depth, RenderItem item);
+        //submit every mesh of the model inside the view frustum, ordered by the depth of its bounds
+        void SubmitModel(RenderPass pass, bool translucent, gps::Model3D& model, glm::mat4 modelMatrix, gps::Shader& shader, glm::mat4 view, glm::mat4 projection);
+        //move the items of a queue recorded on another thread into this one
+        void Append(RenderQueue& other);
+        void Sort();
+        //draw the items of one pass in key order, sets model and normalMatrix for mesh items
+        void ExecutePass(RenderPass pass);
+
+        int getItemCount();
+        //meshes left out by the frustum test since Begin
+        int getCulledItemCount();
+        int getPassItemCount(RenderPass pass);
+
+    private:
+        float farPlane;
+        int culledItemCount;
+        std::vector<RenderItem> items;
+        std::vector<uint64_t> keys;
+        std::vector<uint32_t> order;
+        //radix sort double buffers
+        std::vector<uint64_t> sortKeys;
+        std::vector<uint32_t> sortOrder;
+
+        uint64_t makeKey(RenderPass pass, bool translucent, GLuint shader, GLuint material, float depth);
+        //first position of the pass in the sorted keys
+        size_t findPass(int pass);
+    };
+
+}
+
+#endif /* RenderQueue_hpp */
@@ -1,4 +1,9 @@
 #include "Shader.hpp"
+#include "GLStateCache.hpp"
+#include "Logger.hpp"
+#include "ShaderCache.hpp"
+
+#include <algorithm>
 
 namespace gps {
     std::string Shader::readShaderFile(std::string fileName)
@@ -22,6 +27,43 @@ namespace gps {
         return shaderString;
     }
 
+    std::string Shader::preprocessShaderFile(std::string fileName, const std::string& defines, std::vector<std::string>& includedFiles)
+    {
+        includedFiles.push_back(fileName);
+        std::string directory;
+        size_t separator = fileName.find_last_of("/\\");
+        if (separator != std::string::npos) {
+            directory = fileName.substr(0, separator + 1);
+        }
+
+        std::istringstream source(readShaderFile(fileName));
+        std::string result;
+        std::string line;
+        while (std::getline(source, line)) {
+            //#include "file", relative to the including file, every file is pasted only once
+            if (line.compare(0, 8, "#include") == 0) {
+                size_t open = line.find('"');
+                size_t close = line.find('"', open + 1);
+                if (open == std::string::npos || close == std::string::npos) {
+                    GPS_LOG_WARNING("Malformed include in %s: %s", fileName.c_str(), line.c_str());
+                    continue;
+                }
+                std::string includeName = directory + line.substr(open + 1, close - open - 1);
+                if (std::find(includedFiles.begin(), includedFiles.end(), includeName) == includedFiles.end()) {
+                    result += preprocessShaderFile(includeName, "", includedFiles);
+                }
+                continue;
+            }
+            result += line;
+            result += '\n';
+            //the defines must follow #version
+            if (!defines.empty() && line.compare(0, 8, "#version") == 0) {
+                result += defines;
+            }
+        }
+        return result;
+    }
+
     void Shader::shaderCompileLog(GLuint shaderId)
     {
         GLint success;
@@ -32,11 +74,11 @@ namespace gps {
         if(!success)
         {
             glGetShaderInfoLog(shaderId, 512, NULL, infoLog);
-            std::cout << "Shader compilation error\n" << infoLog << std::endl;
+            GPS_LOG_ERROR("Shader compilation error\n%s", infoLog);
         }
     }
 
-    void Shader::shaderLinkLog(GLuint shaderProgramId)
+    bool Shader::shaderLinkLog(GLuint shaderProgramId)
     {
         GLint success;
         GLchar infoLog[512];
@@ -44,47 +86,189 @@ namespace gps {
         //check linking info
         glGetProgramiv(shaderProgramId, GL_LINK_STATUS, &success);
         if(!success) {
-            glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-            std::cout << "Shader linking error\n" << infoLog << std::endl;
+            glGetProgramInfoLog(shaderProgramId, 512, NULL, infoLog);
+            GPS_LOG_ERROR("Shader linking error\n%s", infoLog);
         }
+        return success == GL_TRUE;
     }
 
-    void Shader::loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName)
-    {
-        //read, parse and compile the vertex shader
-        std::string v = readShaderFile(vertexShaderFileName);
-        const GLchar* vertexShaderString = v.c_str();
-        GLuint vertexShader;
-        vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertexShader, 1, &vertexShaderString, NULL);
-        glCompileShader(vertexShader);
-        //check compilation status
-        shaderCompileLog(vertexShader);
-
-        //read, parse and compile the vertex shader
-        std::string f = readShaderFile(fragmentShaderFileName);
-        const GLchar* fragmentShaderString = f.c_str();
-        GLuint fragmentShader;
-        fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragmentShader, 1, &fragmentShaderString, NULL);
-        glCompileShader(fragmentShader);
-        //check compilation status
-        shaderCompileLog(fragmentShader);
-
-        //attach and link the shader programs
-        this->shaderProgram = glCreateProgram();
-        glAttachShader(this->shaderProgram, vertexShader);
-        glAttachShader(this->shaderProgram, fragmentShader);
-        glLinkProgram(this->shaderProgram);
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
+    GLuint Shader::compileShader(GLenum type, const std::string& source)
+    {
+        const GLchar* shaderString = source.c_str();
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &shaderString, NULL);
+        glCompileShader(shader);
+        return shader;
+    }
+
+    void Shader::loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName, std::string defines)
+    {
+        Submit(vertexShaderFileName, fragmentShaderFileName, defines);
+        Resolve();
+    }
+
+    void Shader::startBuild(ProgramBuild& build)
+    {
+        build.files.clear();
+        std::string v = preprocessShaderFile(this->vertexShaderFileName, this->defines, build.files);
+        std::string f = preprocessShaderFile(this->fragmentShaderFileName, this->defines, build.files);
+
+        build.program = glCreateProgram();
+        build.vertexShader = 0;
+        build.fragmentShader = 0;
+
+        //a linked binary from an earlier run skips the compiler entirely
+        ShaderCache& cache = ShaderCache::get();
+        build.cacheKey = cache.computeKey(v, f, this->defines);
+        if (cache.Load(build.program, build.cacheKey)) {
+            return;
+        }
+
+        //compile and link without asking for the status, which would wait for the driver
+        build.vertexShader = compileShader(GL_VERTEX_SHADER, v);
+        build.fragmentShader = compileShader(GL_FRAGMENT_SHADER, f);
+        glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glAttachShader(build.program, build.vertexShader);
+        glAttachShader(build.program, build.fragmentShader);
+        glLinkProgram(build.program);
+    }
+
+    bool Shader::isBuildComplete(ProgramBuild& build)
+    {
+        if (build.vertexShader == 0) {
+            //loaded from the cache
+            return true;
+        }
+        if (!GLEW_KHR_parallel_shader_compile) {
+            //without the extension any status query blocks, so the program counts as ready
+            return true;
+        }
+        GLint completed = GL_FALSE;
+        glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed == GL_TRUE;
+    }
+
+    bool Shader::finishBuild(ProgramBuild& build)
+    {
+        if (build.vertexShader == 0) {
+            return true;
+        }
+
+        //check compilation status, waits here if the driver is still compiling
+        shaderCompileLog(build.vertexShader);
+        shaderCompileLog(build.fragmentShader);
+        glDetachShader(build.program, build.vertexShader);
+        glDetachShader(build.program, build.fragmentShader);
+        glDeleteShader(build.vertexShader);
+        glDeleteShader(build.fragmentShader);
+        build.vertexShader = 0;
+        build.fragmentShader = 0;
         //check linking info
-        shaderLinkLog(this->shaderProgram);
+        if (!shaderLinkLog(build.program)) {
+            return false;
+        }
+        ShaderCache::get().Store(build.program, build.cacheKey);
+        return true;
+    }
+
+    void Shader::discardBuild(ProgramBuild& build)
+    {
+        //GL defers the deletion until the driver is done with the objects
+        if (build.vertexShader != 0) {
+            glDeleteShader(build.vertexShader);
+            glDeleteShader(build.fragmentShader);
+            build.vertexShader = 0;
+            build.fragmentShader = 0;
+        }
+        glDeleteProgram(build.program);
+        build.program = 0;
+    }
+
+    void Shader::Submit(std::string vertexShaderFileName, std::string fragmentShaderFileName, std::string defines)
+    {
+        this->vertexShaderFileName = vertexShaderFileName;
+        this->fragmentShaderFileName = fragmentShaderFileName;
+        this->defines = defines;
+
+        startBuild(this->build);
+        this->shaderProgram = this->build.program;
+        this->uniformLocations.clear();
+        this->pending = true;
+    }
+
+    bool Shader::isReady()
+    {
+        return !this->pending || isBuildComplete(this->build);
+    }
+
+    void Shader::Resolve()
+    {
+        if (!this->pending) {
+            return;
+        }
+        this->pending = false;
+        finishBuild(this->build);
+    }
+
+    void Shader::SubmitReload()
+    {
+        if (this->reloading) {
+            //the files changed again before the last edit finished compiling, its result is of no use
+            discardBuild(this->reload);
+        }
+        startBuild(this->reload);
+        this->reloading = true;
+    }
+
+    bool Shader::PollReload()
+    {
+        if (!this->reloading || !isBuildComplete(this->reload)) {
+            return false;
+        }
+        this->reloading = false;
+
+        if (!finishBuild(this->reload)) {
+            GPS_LOG_WARNING("Keeping the previous %s program", this->fragmentShaderFileName.c_str());
+            glDeleteProgram(this->reload.program);
+            return false;
+        }
+
+        //the old program may still be bound, its name must not look current to the state cache
+        Resolve();
+        GLStateCache::get().UseProgram(0);
+        glDeleteProgram(this->shaderProgram);
+        this->build = this->reload;
+        this->shaderProgram = this->build.program;
+        this->uniformLocations.clear();
+        return true;
+    }
+
+    bool Shader::usesFile(const std::string& fileName)
+    {
+        return std::find(this->build.files.begin(), this->build.files.end(), fileName) != this->build.files.end();
+    }
+
+    const std::vector<std::string>& Shader::getSourceFiles()
+    {
+        return this->build.files;
     }
 
     void Shader::useShaderProgram()
     {
-        glUseProgram(this->shaderProgram);
+        Resolve();
+        GLStateCache::get().UseProgram(this->shaderProgram);
+    }
+
+    GLint Shader::getUniformLocation(const std::string& name)
+    {
+        Resolve();
+        std::unordered_map<std::string, GLint>::iterator location = this->uniformLocations.find(name);
+        if (location != this->uniformLocations.end()) {
+            return location->second;
+        }
+        GLint newLocation = glGetUniformLocation(this->shaderProgram, name.c_str());
+        this->uniformLocations[name] = newLocation;
+        return newLocation;
     }
 
 }
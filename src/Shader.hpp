@@ -4,10 +4,13 @@
 #include <GL/glew.h>
 
 #include <iostream>
+#include <cstdint>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace gps {
 
@@ -15,13 +18,62 @@ class Shader
 {
 public:
     GLuint shaderProgram;
-    void loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName);
+    //compile and link right away, Submit followed by Resolve
+    void loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName, std::string defines = "");
+    //start compiling and linking, the driver may do it on its own threads with KHR_parallel_shader_compile;
+    //defines - lines of #define pasted after #version, #include "file" is expanded in both sources
+    void Submit(std::string vertexShaderFileName, std::string fragmentShaderFileName, std::string defines = "");
+    //true once the program linked, never waits
+    bool isReady();
+    //wait for the program and check the logs, done by the first use of the program
+    void Resolve();
     void useShaderProgram();
+    //cached glGetUniformLocation, shaders are passed by reference so the cache is kept
+    GLint getUniformLocation(const std::string& name);
+
+    //build the program again from the files, the current one stays in use meanwhile
+    void SubmitReload();
+    //swap in the reloaded program once it linked, true if it was swapped;
+    //never waits with KHR_parallel_shader_compile, without it the first poll waits for the compiler
+    bool PollReload();
+    //true if the file is one of the sources, includes too
+    bool usesFile(const std::string& fileName);
+    const std::vector<std::string>& getSourceFiles();
 
 private:
+    //a program on its way from the sources, the shaders are 0 once checked or if it came from the cache
+    struct ProgramBuild {
+        GLuint program = 0;
+        GLuint vertexShader = 0;
+        GLuint fragmentShader = 0;
+        uint64_t cacheKey = 0;
+        std::vector<std::string> files;
+    };
+
+    std::string vertexShaderFileName;
+    std::string fragmentShaderFileName;
+    std::string defines;
+    std::unordered_map<std::string, GLint> uniformLocations;
+    //build of shaderProgram, pending until its logs were checked
+    ProgramBuild build;
+    bool pending = false;
+    //replacement for shaderProgram after an edit
+    ProgramBuild reload;
+    bool reloading = false;
+
     std::string readShaderFile(std::string fileName);
+    //the source with the includes pasted in, includedFiles collects every file read
+    std::string preprocessShaderFile(std::string fileName, const std::string& defines, std::vector<std::string>& includedFiles);
+    void startBuild(ProgramBuild& build);
+    bool isBuildComplete(ProgramBuild& build);
+    //check the logs and store the binary, true if the program linked
+    bool finishBuild(ProgramBuild& build);
+    //delete an unfinished build without asking for its status, which would wait for the driver
+    void discardBuild(ProgramBuild& build);
+    GLuint compileShader(GLenum type, const std::string& source);
     void shaderCompileLog(GLuint shaderId);
-    void shaderLinkLog(GLuint shaderProgramId);
+    //true if the program linked
+    bool shaderLinkLog(GLuint shaderProgramId);
 };
 
 }
@@ -0,0 +1,144 @@
+#include "ShaderCache.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace gps {
+
+    //written at the start of every file, bumped when the layout changes
+    static const uint32_t SHADER_CACHE_MAGIC = 0x53504731;
+
+    //FNV-1a, 64 bit
+    static uint64_t hashString(uint64_t hash, const std::string& text) {
+        for (size_t i = 0; i < text.size(); i++) {
+            hash ^= (unsigned char)text[i];
+            hash *= 1099511628211ull;
+        }
+        //separator, so moving text between the parts changes the hash
+        hash ^= 0xFF;
+        hash *= 1099511628211ull;
+        return hash;
+    }
+
+    ShaderCache& ShaderCache::get() {
+        static ShaderCache cache;
+        return cache;
+    }
+
+    void ShaderCache::init() {
+        this->initialized = true;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        this->enabled = formats > 0;
+        if (!this->enabled) {
+            return;
+        }
+
+        const char* strings[3] = {
+            (const char*)glGetString(GL_VENDOR),
+            (const char*)glGetString(GL_RENDERER),
+            (const char*)glGetString(GL_VERSION)
+        };
+        for (int i = 0; i < 3; i++) {
+            this->driver += strings[i] != NULL ? strings[i] : "";
+            this->driver += '\n';
+        }
+
+#ifdef _WIN32
+        _mkdir(SHADER_CACHE_DIRECTORY);
+#else
+        mkdir(SHADER_CACHE_DIRECTORY, 0755);
+#endif
+    }
+
+    uint64_t ShaderCache::computeKey(const std::string& vertexSource, const std::string& fragmentSource, const std::string& defines) {
+        if (!this->initialized) {
+            this->init();
+        }
+        uint64_t hash = 14695981039346656037ull;
+        hash = hashString(hash, this->driver);
+        hash = hashString(hash, defines);
+        hash = hashString(hash, vertexSource);
+        hash = hashString(hash, fragmentSource);
+        return hash;
+    }
+
+    std::string ShaderCache::getPath(uint64_t key) {
+        char name[24];
+        std::snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+        return SHADER_CACHE_DIRECTORY + std::string(name);
+    }
+
+    bool ShaderCache::Load(GLuint program, uint64_t key) {
+        if (!this->enabled) {
+            this->misses++;
+            return false;
+        }
+
+        std::ifstream file(this->getPath(key), std::ios::binary);
+        uint32_t header[3];
+        if (!file || !file.read((char*)header, sizeof(header)) || header[0] != SHADER_CACHE_MAGIC) {
+            this->misses++;
+            return false;
+        }
+        GLenum format = header[1];
+        std::vector<char> binary(header[2]);
+        if (binary.empty() || !file.read(&binary[0], binary.size())) {
+            this->misses++;
+            return false;
+        }
+
+        glProgramBinary(program, format, &binary[0], (GLsizei)binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            //the driver changed in a way its version string does not show
+            this->misses++;
+            return false;
+        }
+        this->hits++;
+        return true;
+    }
+
+    void ShaderCache::Store(GLuint program, uint64_t key) {
+        if (!this->enabled) {
+            return;
+        }
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) {
+            return;
+        }
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &length, &format, &binary[0]);
+
+        std::ofstream file(this->getPath(key), std::ios::binary);
+        uint32_t header[3] = { SHADER_CACHE_MAGIC, (uint32_t)format, (uint32_t)length };
+        file.write((const char*)header, sizeof(header));
+        file.write(&binary[0], length);
+    }
+
+    bool ShaderCache::isEnabled() {
+        if (!this->initialized) {
+            this->init();
+        }
+        return this->enabled;
+    }
+
+    int ShaderCache::getHits() {
+        return this->hits;
+    }
+
+    int ShaderCache::getMisses() {
+        return this->misses;
+    }
+}
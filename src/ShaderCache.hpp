@@ -0,0 +1,47 @@
+#ifndef ShaderCache_hpp
+#define ShaderCache_hpp
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+
+namespace gps {
+
+    //folder of the cached program binaries, relative to the working directory like shaders/
+    const char* const SHADER_CACHE_DIRECTORY = "shadercache";
+
+    //linked program binaries on disk, keyed by a hash of the sources, the defines and the driver;
+    //a new driver or an edited shader changes the key, stale files are simply never read again
+    class ShaderCache
+    {
+    public:
+        static ShaderCache& get();
+
+        //hash of the sources and the driver strings, the context must be current
+        uint64_t computeKey(const std::string& vertexSource, const std::string& fragmentSource, const std::string& defines);
+        //load the binary into program, false if there is none or the driver rejects it
+        bool Load(GLuint program, uint64_t key);
+        //save the binary of a linked program, the program needs GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+        void Store(GLuint program, uint64_t key);
+        //false if the driver supports no binary format, the cache then does nothing
+        bool isEnabled();
+
+        int getHits();
+        int getMisses();
+
+    private:
+        bool initialized = false;
+        bool enabled = false;
+        //vendor, renderer and version, part of every key
+        std::string driver;
+        int hits = 0;
+        int misses = 0;
+
+        void init();
+        std::string getPath(uint64_t key);
+    };
+
+}
+
+#endif /* ShaderCache_hpp */
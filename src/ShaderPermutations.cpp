@@ -0,0 +1,51 @@
+#include "ShaderPermutations.hpp"
+
+namespace gps {
+
+    void ShaderPermutations::Init(std::string vertexShaderFileName, std::string fragmentShaderFileName) {
+        this->vertexShaderFileName = vertexShaderFileName;
+        this->fragmentShaderFileName = fragmentShaderFileName;
+    }
+
+    void ShaderPermutations::Submit(unsigned int features, int pointLights) {
+        this->get(features, pointLights);
+    }
+
+    gps::Shader& ShaderPermutations::get(unsigned int features, int pointLights) {
+        uint32_t key = (features & 0xFF) | ((uint32_t)pointLights << 8);
+        std::map<uint32_t, gps::Shader>::iterator variant = this->variants.find(key);
+        if (variant != this->variants.end()) {
+            return variant->second;
+        }
+
+        gps::Shader& shader = this->variants[key];
+        shader.Submit(this->vertexShaderFileName, this->fragmentShaderFileName, getDefines(features, pointLights));
+        return shader;
+    }
+
+    std::vector<gps::Shader*> ShaderPermutations::getVariants() {
+        std::vector<gps::Shader*> shaders;
+        for (std::map<uint32_t, gps::Shader>::iterator variant = this->variants.begin(); variant != this->variants.end(); ++variant) {
+            shaders.push_back(&variant->second);
+        }
+        return shaders;
+    }
+
+    std::string ShaderPermutations::getDefines(unsigned int features, int pointLights) {
+        std::string defines;
+        if (features & SHADER_SHADOWS) {
+            defines += "#define SHADOWS\n";
+        }
+        if (features & SHADER_SHADOW_EVSM) {
+            defines += "#define SHADOW_EVSM\n";
+        }
+        if (features & SHADER_FOG) {
+            defines += "#define FOG\n";
+        }
+        if (features & SHADER_ALPHA_BLEND) {
+            defines += "#define ALPHA_BLEND\n";
+        }
+        defines += "#define NUM_POINT_LIGHTS " + std::to_string(pointLights) + "\n";
+        return defines;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef ShaderPermutations_hpp
+#define ShaderPermutations_hpp
+
+#include "Shader.hpp"
+#include "ClusteredLights.hpp"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    //compile time features of the lighting shaders, each one a #define in the sources
+    enum ShaderFeature {
+        SHADER_SHADOWS = 1 << 0,
+        SHADER_SHADOW_EVSM = 1 << 1,
+        SHADER_FOG = 1 << 2,
+        SHADER_ALPHA_BLEND = 1 << 3
+    };
+
+    //point lights a fragment shades unless a material asks for fewer
+    const int DEFAULT_POINT_LIGHTS = MAX_LIGHTS_PER_CLUSTER;
+
+    //variants of one vertex and fragment shader pair, specialized with #defines
+    //so that every draw runs only the code its material needs
+    class ShaderPermutations
+    {
+    public:
+        void Init(std::string vertexShaderFileName, std::string fragmentShaderFileName);
+        //start compiling a variant before it is first drawn with
+        void Submit(unsigned int features, int pointLights = DEFAULT_POINT_LIGHTS);
+        //the variant with the features, submitted on its first request; the reference stays valid
+        gps::Shader& get(unsigned int features, int pointLights = DEFAULT_POINT_LIGHTS);
+        //every variant submitted so far, for the uniforms they all share
+        std::vector<gps::Shader*> getVariants();
+
+        static std::string getDefines(unsigned int features, int pointLights);
+
+    private:
+        std::string vertexShaderFileName;
+        std::string fragmentShaderFileName;
+        //features in the low bits, point lights above; map nodes never move
+        std::map<uint32_t, gps::Shader> variants;
+    };
+
+}
+
+#endif /* ShaderPermutations_hpp */
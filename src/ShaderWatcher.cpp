@@ -0,0 +1,117 @@
+#include "ShaderWatcher.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+namespace gps {
+
+#ifndef __linux__
+    static time_t getModificationTime(const std::string& fileName) {
+        struct stat info;
+        if (stat(fileName.c_str(), &info) != 0) {
+            return 0;
+        }
+        return info.st_mtime;
+    }
+#endif
+
+    void ShaderWatcher::Init() {
+#ifdef __linux__
+        this->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (this->inotify < 0) {
+            GPS_LOG_WARNING("Could not start watching the shader files");
+        }
+#else
+        this->lastCheck = std::chrono::steady_clock::now();
+#endif
+    }
+
+    void ShaderWatcher::Watch(const std::string& fileName) {
+        if (std::find(this->files.begin(), this->files.end(), fileName) != this->files.end()) {
+            return;
+        }
+        this->files.push_back(fileName);
+
+#ifdef __linux__
+        //editors often save by writing a new file and renaming it, so the directory is watched
+        size_t separator = fileName.find_last_of('/');
+        std::string directory = separator == std::string::npos ? "./" : fileName.substr(0, separator + 1);
+        for (std::map<int, std::string>::iterator watch = this->directories.begin(); watch != this->directories.end(); ++watch) {
+            if (watch->second == directory) {
+                return;
+            }
+        }
+        if (this->inotify >= 0) {
+            int descriptor = inotify_add_watch(this->inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (descriptor >= 0) {
+                this->directories[descriptor] = directory;
+            }
+        }
+#else
+        this->modificationTimes.push_back(getModificationTime(fileName));
+#endif
+    }
+
+    std::vector<std::string> ShaderWatcher::PollChanges() {
+        std::vector<std::string> changed;
+
+#ifdef __linux__
+        if (this->inotify < 0) {
+            return changed;
+        }
+        alignas(struct inotify_event) char buffer[4096];
+        for (;;) {
+            ssize_t length = read(this->inotify, buffer, sizeof(buffer));
+            if (length <= 0) {
+                break;
+            }
+            for (ssize_t offset = 0; offset < length; ) {
+                const struct inotify_event* event = (const struct inotify_event*)(buffer + offset);
+                offset += sizeof(struct inotify_event) + event->len;
+                if (event->len == 0 || this->directories.count(event->wd) == 0) {
+                    continue;
+                }
+                std::string fileName = this->directories[event->wd] + event->name;
+                //a file that is not a source of any shader, or reported twice
+                if (std::find(this->files.begin(), this->files.end(), fileName) != this->files.end() &&
+                    std::find(changed.begin(), changed.end(), fileName) == changed.end()) {
+                    changed.push_back(fileName);
+                }
+            }
+        }
+#else
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (std::chrono::duration<double>(now - this->lastCheck).count() < SHADER_WATCH_INTERVAL) {
+            return changed;
+        }
+        this->lastCheck = now;
+        for (size_t i = 0; i < this->files.size(); i++) {
+            time_t modified = getModificationTime(this->files[i]);
+            if (modified != this->modificationTimes[i]) {
+                this->modificationTimes[i] = modified;
+                changed.push_back(this->files[i]);
+            }
+        }
+#endif
+        return changed;
+    }
+
+    void ShaderWatcher::Delete() {
+#ifdef __linux__
+        if (this->inotify >= 0) {
+            close(this->inotify);
+        }
+        this->inotify = -1;
+        this->directories.clear();
+#endif
+        this->files.clear();
+    }
+}
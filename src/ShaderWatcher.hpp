@@ -0,0 +1,41 @@
+#ifndef ShaderWatcher_hpp
+#define ShaderWatcher_hpp
+
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    //seconds between two checks of the modification times where inotify is missing
+    const double SHADER_WATCH_INTERVAL = 0.25;
+
+    //reports the shader files written since the last poll;
+    //inotify on Linux, the modification times of the files everywhere else
+    class ShaderWatcher
+    {
+    public:
+        void Init();
+        //watching a file twice does nothing
+        void Watch(const std::string& fileName);
+        //changed watched files, never blocks
+        std::vector<std::string> PollChanges();
+        void Delete();
+
+    private:
+        std::vector<std::string> files;
+#ifdef __linux__
+        int inotify = -1;
+        //directory of every watch descriptor, with the trailing separator
+        std::map<int, std::string> directories;
+#else
+        std::vector<time_t> modificationTimes;
+        std::chrono::steady_clock::time_point lastCheck;
+#endif
+    };
+
+}
+
+#endif /* ShaderWatcher_hpp */
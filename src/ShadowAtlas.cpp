@@ -0,0 +1,311 @@
+#include "ShadowAtlas.hpp"
+#include "GLStateCache.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace gps {
+
+    const float SHADOW_LIGHT_NEAR_PLANE = 0.1f;
+
+    void ShadowAtlas::Init(unsigned int atlasSize, unsigned int minTileSize, unsigned int maxTileSize) {
+        this->atlasSize = atlasSize;
+        this->minTileSize = minTileSize;
+        this->maxTileSize = glm::min(maxTileSize, atlasSize);
+
+        //one quadtree level per tile size, from the whole atlas down to the smallest tile
+        this->levelCount = 1;
+        while ((atlasSize >> this->levelCount) >= minTileSize) {
+            this->levelCount++;
+        }
+        int nodeCount = 0;
+        for (int level = 0, levelNodes = 1; level < this->levelCount; level++, levelNodes *= 4) {
+            nodeCount += levelNodes;
+        }
+        this->nodes.assign(nodeCount, NODE_FREE);
+
+        glGenTextures(1, &this->depthTexture);
+        GLStateCache::get().BindTexture(0, GL_TEXTURE_2D, this->depthTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F,
+            atlasSize, atlasSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        //hardware comparison gives 2x2 filtering for free
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glGenFramebuffers(1, &this->framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, this->depthTexture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void ShadowAtlas::Update(std::vector<ShadowLight> lights, glm::mat4 view, float fovY, int viewportHeight,
+        std::vector<BoundingBox> movedCasters) {
+        //lights that were removed give their tiles back
+        for (size_t i = lights.size(); i < this->slots.size(); i++) {
+            this->freeTiles(this->slots[i]);
+        }
+        this->slots.resize(lights.size());
+
+        std::vector<unsigned int> desiredSizes(lights.size());
+        std::vector<int> order(lights.size());
+        for (size_t i = 0; i < lights.size(); i++) {
+            desiredSizes[i] = this->computeTileSize(lights[i], view, fovY, viewportHeight);
+            order[i] = (int)i;
+
+            //keep the current tiles unless the light grew or became much smaller, so the tiles do not
+            //move around and get rendered again every frame; compared with the size asked for, a light that
+            //got smaller fallback tiles would otherwise give them back and get the same size every frame
+            LightSlot& slot = this->slots[i];
+            int tileCount = lights[i].type == SHADOW_LIGHT_POINT ? 6 : 1;
+            bool keep = !slot.tiles.empty() && (int)slot.tiles.size() == tileCount &&
+                desiredSizes[i] <= slot.requestedSize && desiredSizes[i] * 2 >= slot.requestedSize;
+            if (!keep) {
+                this->freeTiles(slot);
+            }
+            slot.light = lights[i];
+        }
+
+        //the most important lights get the first pick of the free space
+        std::stable_sort(order.begin(), order.end(), [&desiredSizes](int a, int b) {
+            return desiredSizes[a] > desiredSizes[b];
+        });
+
+        int usedTiles = 0;
+        for (size_t i = 0; i < this->slots.size(); i++) {
+            usedTiles += (int)this->slots[i].tiles.size();
+        }
+        for (size_t i = 0; i < order.size(); i++) {
+            LightSlot& slot = this->slots[order[i]];
+            int tileCount = slot.light.type == SHADOW_LIGHT_POINT ? 6 : 1;
+            if (!slot.tiles.empty() || usedTiles + tileCount > MAX_SHADOW_TILES) {
+                continue;
+            }
+            //fall back to smaller tiles when the atlas is full
+            for (unsigned int size = desiredSizes[order[i]]; size >= this->minTileSize; size /= 2) {
+                if (this->allocateTiles(slot, size, tileCount)) {
+                    slot.requestedSize = desiredSizes[order[i]];
+                    usedTiles += tileCount;
+                    break;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < this->slots.size(); i++) {
+            LightSlot& slot = this->slots[i];
+            this->computeTileMatrices(slot);
+
+            //tiles of lights reached by a moving caster must be rendered again
+            for (size_t c = 0; c < movedCasters.size(); c++) {
+                if (this->IsCasterVisible((int)i, movedCasters[c])) {
+                    for (size_t t = 0; t < slot.tiles.size(); t++) {
+                        slot.tiles[t].valid = false;
+                    }
+                    break;
+                }
+            }
+        }
+
+        //flat list of the tiles, in the order they are sent to the shaders
+        this->firstTiles.assign(this->slots.size(), -1);
+        this->frameTiles.clear();
+        for (size_t i = 0; i < this->slots.size(); i++) {
+            if (this->slots[i].tiles.empty())
+                continue;
+            this->firstTiles[i] = (int)this->frameTiles.size();
+            for (size_t t = 0; t < this->slots[i].tiles.size(); t++) {
+                this->frameTiles.push_back(&this->slots[i].tiles[t]);
+            }
+        }
+    }
+
+    unsigned int ShadowAtlas::computeTileSize(ShadowLight light, glm::mat4 view, float fovY, int viewportHeight) {
+        glm::vec3 positionEye = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        float distance = glm::length(positionEye);
+        if (distance <= light.range) {
+            return this->maxTileSize;
+        }
+        //the sphere of influence is behind the camera
+        if (positionEye.z - light.range > 0.0f) {
+            return this->minTileSize;
+        }
+
+        //projected diameter of the sphere of influence, in pixels
+        float projectedSize = (light.range / distance) * (float)viewportHeight / std::tan(fovY * 0.5f);
+        unsigned int size = this->minTileSize;
+        while ((float)size < projectedSize && size < this->maxTileSize) {
+            size *= 2;
+        }
+        return size;
+    }
+
+    bool ShadowAtlas::allocateTiles(LightSlot& slot, unsigned int tileSize, int tileCount) {
+        int targetLevel = 0;
+        while ((this->atlasSize >> targetLevel) > tileSize) {
+            targetLevel++;
+        }
+
+        slot.tiles.resize(tileCount);
+        for (int i = 0; i < tileCount; i++) {
+            if (this->allocateNode(0, 0, targetLevel, 0, 0, slot.tiles[i]) < 0) {
+                //not enough space for every face, give back the ones already taken
+                slot.tiles.resize(i);
+                this->freeTiles(slot);
+                return false;
+            }
+            slot.tiles[i].size = tileSize;
+            slot.tiles[i].valid = false;
+        }
+        slot.tileSize = tileSize;
+        return true;
+    }
+
+    void ShadowAtlas::freeTiles(LightSlot& slot) {
+        for (size_t i = 0; i < slot.tiles.size(); i++) {
+            this->freeNode(slot.tiles[i].node);
+        }
+        slot.tiles.clear();
+        slot.tileSize = 0;
+        slot.requestedSize = 0;
+    }
+
+    int ShadowAtlas::allocateNode(int node, int level, int targetLevel, unsigned int x, unsigned int y, Tile& tile) {
+        if (this->nodes[node] == NODE_USED) {
+            return -1;
+        }
+        if (level == targetLevel) {
+            if (this->nodes[node] != NODE_FREE) {
+                return -1;
+            }
+            this->nodes[node] = NODE_USED;
+            tile.node = node;
+            tile.x = x;
+            tile.y = y;
+            return node;
+        }
+
+        bool wasFree = this->nodes[node] == NODE_FREE;
+        this->nodes[node] = NODE_SPLIT;
+        unsigned int half = (this->atlasSize >> level) / 2;
+        for (int c = 0; c < 4; c++) {
+            int allocated = this->allocateNode(4 * node + 1 + c, level + 1, targetLevel,
+                x + (c & 1) * half, y + (c >> 1) * half, tile);
+            if (allocated >= 0) {
+                return allocated;
+            }
+        }
+        if (wasFree) {
+            this->nodes[node] = NODE_FREE;
+        }
+        return -1;
+    }
+
+    void ShadowAtlas::freeNode(int node) {
+        this->nodes[node] = NODE_FREE;
+        //merge the siblings back into their parent once all of them are free
+        while (node > 0) {
+            int parent = (node - 1) / 4;
+            for (int c = 0; c < 4; c++) {
+                if (this->nodes[4 * parent + 1 + c] != NODE_FREE) {
+                    return;
+                }
+            }
+            this->nodes[parent] = NODE_FREE;
+            node = parent;
+        }
+    }
+
+    void ShadowAtlas::computeTileMatrices(LightSlot& slot) {
+        const ShadowLight& light = slot.light;
+
+        if (light.type == SHADOW_LIGHT_POINT) {
+            //cube faces in the order +x, -x, +y, -y, +z, -z
+            const glm::vec3 directions[6] = {
+                glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+                glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+                glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+            };
+            const glm::vec3 ups[6] = {
+                glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+                glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+                glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+            };
+            glm::mat4 faceProjection = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_LIGHT_NEAR_PLANE, light.range);
+            for (size_t i = 0; i < slot.tiles.size(); i++) {
+                slot.tiles[i].lightSpaceTrMatrix = faceProjection *
+                    glm::lookAt(light.position, light.position + directions[i], ups[i]);
+            }
+        }
+        else if (!slot.tiles.empty()) {
+            glm::vec3 direction = glm::normalize(light.direction);
+            glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            slot.tiles[0].lightSpaceTrMatrix =
+                glm::perspective(2.0f * light.outerAngle, 1.0f, SHADOW_LIGHT_NEAR_PLANE, light.range) *
+                glm::lookAt(light.position, light.position + direction, up);
+        }
+    }
+
+    int ShadowAtlas::getFirstTile(int light) {
+        return this->firstTiles[light];
+    }
+
+    int ShadowAtlas::getTileCount(int light) {
+        return (int)this->slots[light].tiles.size();
+    }
+
+    int ShadowAtlas::getAllocatedTileCount() {
+        return (int)this->frameTiles.size();
+    }
+
+    bool ShadowAtlas::NeedsRender(int tile) {
+        Tile* t = this->frameTiles[tile];
+        return !t->valid || t->renderedMatrix != t->lightSpaceTrMatrix;
+    }
+
+    void ShadowAtlas::BindTile(int tile) {
+        Tile* t = this->frameTiles[tile];
+
+        glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+        glViewport(t->x, t->y, t->size, t->size);
+        //only clear the tile, the rest of the atlas is still valid
+        GLStateCache::get().SetEnabled(GL_SCISSOR_TEST, true);
+        glScissor(t->x, t->y, t->size, t->size);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        GLStateCache::get().SetEnabled(GL_SCISSOR_TEST, false);
+
+        t->renderedMatrix = t->lightSpaceTrMatrix;
+        t->valid = true;
+    }
+
+    bool ShadowAtlas::IsCasterVisible(int light, BoundingBox worldBounds) {
+        //distance from the light to the closest point of the box
+        const ShadowLight& l = this->slots[light].light;
+        glm::vec3 closest = glm::clamp(l.position, worldBounds.min, worldBounds.max);
+        return glm::length(closest - l.position) <= l.range;
+    }
+
+    void ShadowAtlas::Delete() {
+        GLStateCache::get().ForgetTexture(this->depthTexture);
+        glDeleteTextures(1, &this->depthTexture);
+        glDeleteFramebuffers(1, &this->framebuffer);
+    }
+
+    glm::mat4 ShadowAtlas::getLightSpaceTrMatrix(int tile) {
+        return this->frameTiles[tile]->lightSpaceTrMatrix;
+    }
+
+    glm::vec4 ShadowAtlas::getTileRect(int tile) {
+        Tile* t = this->frameTiles[tile];
+        float scale = 1.0f / (float)this->atlasSize;
+        return glm::vec4(t->x * scale, t->y * scale, t->size * scale, t->size * scale);
+    }
+
+    GLuint ShadowAtlas::getDepthTexture() {
+        return this->depthTexture;
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef ShadowAtlas_hpp
+#define ShadowAtlas_hpp
+
+#include <GL/glew.h>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "Mesh.hpp"
+
+#include <vector>
+
+namespace gps {
+
+    //must match MAX_SHADOW_TILES in the shaders
+    const int MAX_SHADOW_TILES = 32;
+
+    enum ShadowLightType { SHADOW_LIGHT_SPOT, SHADOW_LIGHT_POINT };
+
+    struct ShadowLight {
+        ShadowLightType type;
+        glm::vec3 position;
+        //spot lights only
+        glm::vec3 direction;
+        //half angle of the spot cone, in radians
+        float outerAngle;
+        //distance after which the light has no effect
+        float range;
+    };
+
+    class ShadowAtlas
+    {
+    public:
+        //create the atlas depth texture, tiles are square powers of two between minTileSize and maxTileSize
+        void Init(unsigned int atlasSize, unsigned int minTileSize, unsigned int maxTileSize);
+        //assign tiles to the lights based on their size on screen, the lights must keep their index between frames
+        //movedCasters - world bounds of the casters that moved since the last frame
+        void Update(std::vector<ShadowLight> lights, glm::mat4 view, float fovY, int viewportHeight,
+            std::vector<BoundingBox> movedCasters);
+        //first tile of the light, or -1 if it did not get a place in the atlas
+        int getFirstTile(int light);
+        //1 for spot lights, 6 cube faces for point lights
+        int getTileCount(int light);
+        //number of tiles used this frame
+        int getAllocatedTileCount();
+        //true if the tile changed since it was rendered
+        bool NeedsRender(int tile);
+        //bind the atlas, restrict the viewport to the tile and clear it
+        void BindTile(int tile);
+        //true if a caster with the given world bounds is inside the range of the light
+        bool IsCasterVisible(int light, BoundingBox worldBounds);
+        void Delete();
+
+        glm::mat4 getLightSpaceTrMatrix(int tile);
+        //xy - offset, zw - scale of the tile in atlas texture coordinates
+        glm::vec4 getTileRect(int tile);
+        GLuint getDepthTexture();
+
+    private:
+        enum NodeState { NODE_FREE, NODE_SPLIT, NODE_USED };
+
+        struct Tile {
+            int node;
+            unsigned int x;
+            unsigned int y;
+            unsigned int size;
+            glm::mat4 lightSpaceTrMatrix;
+            //the matrix the tile was last rendered with
+            glm::mat4 renderedMatrix;
+            bool valid;
+        };
+
+        struct LightSlot {
+            ShadowLight light;
+            unsigned int tileSize;
+            //size the light asked for when it got its tiles, larger than tileSize when the atlas was full
+            unsigned int requestedSize;
+            std::vector<Tile> tiles;
+        };
+
+        GLuint framebuffer;
+        GLuint depthTexture;
+        unsigned int atlasSize;
+        unsigned int minTileSize;
+        unsigned int maxTileSize;
+        //complete quadtree over the atlas, children of node i are 4i+1 to 4i+4
+        std::vector<NodeState> nodes;
+        int levelCount;
+        std::vector<LightSlot> slots;
+        //index of the first tile of every light in the flat tile list of this frame
+        std::vector<int> firstTiles;
+        std::vector<Tile*> frameTiles;
+
+        unsigned int computeTileSize(ShadowLight light, glm::mat4 view, float fovY, int viewportHeight);
+        bool allocateTiles(LightSlot& slot, unsigned int tileSize, int tileCount);
+        void freeTiles(LightSlot& slot);
+        int allocateNode(int node, int level, int targetLevel, unsigned int x, unsigned int y, Tile& tile);
+        void freeNode(int node);
+        void computeTileMatrices(LightSlot& slot);
+    };
+
+}
+
+#endif /* ShadowAtlas_hpp */
@@ -0,0 +1,88 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace gps {
+
+    void ThreadPool::Init(int threadCount) {
+        if (threadCount <= 0) {
+            threadCount = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+        }
+        this->stopping = false;
+        this->pendingJobs = 0;
+        for (int i = 0; i < threadCount; i++) {
+            this->threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+        }
+    }
+
+    void ThreadPool::Submit(std::function<void(int worker)> job) {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->jobs.push_back(job);
+            this->pendingJobs++;
+        }
+        this->jobAvailable.notify_one();
+    }
+
+    void ThreadPool::ParallelFor(int count, std::function<void(int index, int worker)> function) {
+        //a few jobs per worker, so uneven items still spread out
+        int chunkCount = std::min(count, (int)this->threads.size() * 4);
+        for (int chunk = 0; chunk < chunkCount; chunk++) {
+            int begin = count * chunk / chunkCount;
+            int end = count * (chunk + 1) / chunkCount;
+            this->Submit([function, begin, end](int worker) {
+                for (int i = begin; i < end; i++) {
+                    function(i, worker);
+                }
+            });
+        }
+    }
+
+    void ThreadPool::Wait() {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->jobsDone.wait(lock, [this]() { return this->pendingJobs == 0; });
+    }
+
+    void ThreadPool::Delete() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->jobAvailable.notify_all();
+        for (std::thread& thread : this->threads) {
+            thread.join();
+        }
+        this->threads.clear();
+        this->jobs.clear();
+    }
+
+    int ThreadPool::getThreadCount() {
+        return (int)this->threads.size();
+    }
+
+    void ThreadPool::workerLoop(int worker) {
+        while (true) {
+            std::function<void(int)> job;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->jobAvailable.wait(lock, [this]() { return this->stopping || !this->jobs.empty(); });
+                if (this->stopping && this->jobs.empty()) {
+                    return;
+                }
+                job = this->jobs.front();
+                this->jobs.pop_front();
+            }
+
+            job(worker);
+
+            bool done;
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                done = --this->pendingJobs == 0;
+            }
+            if (done) {
+                this->jobsDone.notify_all();
+            }
+        }
+    }
+}
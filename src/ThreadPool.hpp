@@ -0,0 +1,44 @@
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gps {
+
+    //fixed set of worker threads, the jobs never touch GL, only the main thread owns the context
+    class ThreadPool
+    {
+    public:
+        //threadCount 0 - one worker for every core left after the main thread
+        void Init(int threadCount);
+        //the job receives the index of the worker running it, for thread local data
+        void Submit(std::function<void(int worker)> job);
+        //run function(index, worker) for every index in [0, count), returns without waiting
+        void ParallelFor(int count, std::function<void(int index, int worker)> function);
+        //block until every submitted job has finished
+        void Wait();
+        void Delete();
+
+        int getThreadCount();
+
+    private:
+        std::vector<std::thread> threads;
+        std::deque<std::function<void(int)>> jobs;
+        std::mutex mutex;
+        std::condition_variable jobAvailable;
+        std::condition_variable jobsDone;
+        //queued and running jobs
+        int pendingJobs = 0;
+        bool stopping = false;
+
+        void workerLoop(int worker);
+    };
+
+}
+
+#endif /* ThreadPool_hpp */
@@ -1,8 +1,14 @@
 #include "Window.h"
+#include "Logger.hpp"
 
 namespace gps {
 
-    void Window::Create(int width, int height, const char *title) {
+    void Window::Create(int width, int height, const char *title, bool headless) {
+#ifdef GLFW_PLATFORM_NULL
+        //GLFW 3.4, OSMesa renders with llvmpipe without a GPU or a display server
+        if (headless)
+            glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
         if (!glfwInit()) {
             throw std::runtime_error("Could not start GLFW3!");
         }
@@ -19,6 +25,18 @@ namespace gps {
         // for multisampling/antialising
         glfwWindowHint(GLFW_SAMPLES, 4);
 
+        if (headless) {
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            //the frames go to an offscreen framebuffer, the window surface is never shown
+            glfwWindowHint(GLFW_SAMPLES, 0);
+#ifdef GLFW_PLATFORM_NULL
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#else
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+            GPS_LOG_WARNING("GLFW before 3.4 has no null platform, the hidden window needs a display server");
+#endif
+        }
+
         this->window = glfwCreateWindow(width, height, title, NULL, NULL);
         if (!this->window) {
             throw std::runtime_error("Could not create GLFW3 window!");
@@ -26,17 +44,22 @@ namespace gps {
 
         glfwMakeContextCurrent(window);
 
-        glfwSwapInterval(1);
+        //no vsync when benchmarking
+        glfwSwapInterval(headless ? 0 : 1);
 
         // start GLEW extension handler
         glewExperimental = GL_TRUE;
-        glewInit();
+        //a GLEW built for another context API loads no function at all
+        GLenum glewStatus = glewInit();
+        if (glewStatus != GLEW_OK) {
+            throw std::runtime_error(std::string("Could not start GLEW: ") + (const char*)glewGetErrorString(glewStatus));
+        }
 
         // get version info
         const GLubyte* renderer = glGetString(GL_RENDERER); // get renderer string
         const GLubyte* version = glGetString(GL_VERSION); // version as a string
-        std::cout << "Renderer: " << renderer << std::endl;
-        std::cout << "OpenGL version: " << version << std::endl;
+        GPS_LOG_INFO("Renderer: %s", (const char*)renderer);
+        GPS_LOG_INFO("OpenGL version: %s", (const char*)version);
 
         //for RETINA display
         glfwGetFramebufferSize(window, &this->dimensions.width, &this->dimensions.height);
@@ -16,7 +16,9 @@ namespace gps {
     class Window {
 
     public:
-        void Create(int width=800, int height=600, const char *title="OpenGL Project");
+        //headless - hidden window, the context does not need a display when GLFW provides the null platform (3.4);
+        //older GLFW still opens the hidden window on X11 or Wayland, so a display server is needed
+        void Create(int width=800, int height=600, const char *title="OpenGL Project", bool headless=false);
         void Delete();
 
         GLFWwindow* getWindow();
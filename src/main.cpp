@@ -9,11 +9,34 @@
 
 #include "Window.h"
 #include "Shader.hpp"
+#include "ShaderCache.hpp"
+#include "ShaderPermutations.hpp"
+#include "ShaderWatcher.hpp"
+#include "CameraPath.hpp"
+#include "CameraRecording.hpp"
+#include "Logger.hpp"
 #include "Camera.hpp"
 #include "Model3D.hpp"
 #include "SkyBox.hpp"
-
+#include "CascadedShadowMap.hpp"
+#include "ShadowAtlas.hpp"
+#include "ClusteredLights.hpp"
+#include "GBuffer.hpp"
+#include "GLStateCache.hpp"
+#include "RenderQueue.hpp"
+#include "FrameGraph.hpp"
+#include "ThreadPool.hpp"
+#include "Benchmark.hpp"
+#include "Profiler.hpp"
+#include "OffscreenTarget.hpp"
+#include "FrameCapture.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 
 // window
 gps::Window myWindow;
@@ -24,11 +47,23 @@ std::vector<const GLchar*> faces;
 
 // Scene proprieties
 const float fov = 1000.0f;
+const float cameraFieldOfView = 45.0f;
+const float cameraNearPlane = 0.1f;
+
+const unsigned int SHADOW_CASCADE_RESOLUTION = 2048;
+const int SHADOW_CASCADE_COUNT = 3;
+// view distance covered by the shadow cascades
+const float SHADOW_DISTANCE = 60.0f;
 
-const unsigned int SHADOW_WIDTH = 4096;
-const unsigned int SHADOW_HEIGHT = 4096;
+// shadows of the local lights
+const unsigned int SHADOW_ATLAS_SIZE = 2048;
+const unsigned int SHADOW_ATLAS_MIN_TILE = 128;
+const unsigned int SHADOW_ATLAS_MAX_TILE = 1024;
+const float SECONDARY_LIGHT_RANGE = 25.0f;
 
-const GLfloat near_plane = 0.1f, far_plane = 30.0f;
+// grid of small unshadowed point lights spread over the scene
+const int EXTRA_LIGHT_GRID = 16;
+const float EXTRA_LIGHT_HEIGHT = 0.5f;
 
 // matrices
 glm::mat4 model;
@@ -36,9 +71,6 @@ glm::mat4 view;
 glm::mat4 projection;
 glm::mat3 normalMatrix;
 glm::mat4 lightYmovement;
-glm::mat4 mainLightSpaceTrMatrix;   
-glm::mat4 lightProjection = glm::ortho(-100.0f, 100.0f, -5.0f, 5.0f, near_plane, far_plane);
-glm::mat4 lightView;
 
 // light parameters
 
@@ -64,6 +96,7 @@ gps::Camera myCamera(
     glm::vec3(0.0f, 0.0f, -10.0f),
     glm::vec3(0.0f, 1.0f, 0.0f));
 
+// per simulation step, like every other animation speed
 GLfloat cameraSpeed = 0.05f;
 
 GLboolean pressedKeys[1024];
@@ -90,19 +123,177 @@ GLfloat lightAngle = 0.0f;
 float angleY = 0.0f;
 float Ypos = 1.0f;
 //shadows
-GLuint shadowMapFBO;
-GLuint depthMapTexture;
+gps::CascadedShadowMap shadowCascades;
+gps::ShadowAtlas shadowAtlas;
+// lights with a place in the shadow atlas, the index of a light must not change between frames
+std::vector<gps::ShadowLight> shadowLights;
+//point lights, binned into view space clusters every frame
+gps::ClusteredLights clusteredLights;
+std::vector<gps::PointLight> pointLights;
+bool showExtraLights = false;
+
+// forward shading or G-buffer followed by a full screen lighting pass
+enum RenderPath { RENDER_FORWARD = 0, RENDER_DEFERRED = 1 };
+RenderPath renderPath = RENDER_FORWARD;
+gps::GBuffer gBuffer;
+
+// --benchmark: the Bezier flythrough rendered offscreen for a fixed number of frames, statistics written as JSON
+bool benchmarkMode = false;
+int benchmarkFrames = 1000;
+bool benchmarkFramesSet = false;
+const int BENCHMARK_WARMUP_FRAMES = 60;
+std::string benchmarkOutput = "benchmark.json";
+gps::Benchmark benchmark;
+
+// --record path: save the camera of every simulation step, --replay path: drive the camera from such a file,
+// with --benchmark the replay is the measured workload
+std::string cameraRecordPath;
+std::string cameraReplayPath;
+gps::CameraRecording cameraRecording;
+bool cameraReplayActive = false;
+int cameraReplayStep = 0;
+
+// --poses file, --turntable N or --flythrough N: render the camera poses to images and exit
+bool batchMode = false;
+std::string batchPosesPath;
+int batchTurntableFrames = 0;
+int batchFlythroughFrames = 0;
+std::string batchOutputDirectory = ".";
+// --format png|qoi|ppm|y4m, --output-dir - streams Y4M to stdout
+gps::ImageFormat batchImageFormat = gps::IMAGE_PNG;
+// --sync-readback: read every frame with a blocking glReadPixels, to compare with the PBO ring
+bool batchSyncReadback = false;
+struct CameraPose {
+    glm::vec3 position;
+    glm::vec3 target;
+};
+// used instead of the camera while a pose is rendered
+bool poseViewActive = false;
+glm::mat4 poseView;
+
+// --width and --height, size of the window or of the offscreen target
+int windowWidth = 1024;
+int windowHeight = 768;
+// target of the final passes, 0 - the window, the offscreen target without a visible window
+GLuint sceneFramebuffer = 0;
+gps::OffscreenTarget offscreenTarget;
+
+// the simulation advances in fixed steps, independent of the frame rate
+const double SIMULATION_STEP = 1.0 / 60.0;
+// longest frame time caught up at once, a stall does not trigger a burst of steps
+const double MAX_SIMULATION_LAG = 0.25;
+// the animated values of one step, the rendered frame blends the last two steps
+struct SimulationState {
+    glm::vec3 cameraPosition;
+    float lightAngle;
+    float frontDoorRotationAngle;
+};
+SimulationState previousSimulation;
+SimulationState currentSimulation;
+double simulationAccumulator = 0.0;
+// position of the rendered frame between the previous and the current step
+float simulationAlpha = 0.0f;
+
+// what the GL thread needs from the simulation, copied once per frame so the workers can
+// record the next frame while the current one is submitted
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 lightRotation;
+    float frontDoorRotationAngle;
+    glm::mat4 frontDoorModel;
+    RenderPath renderPath;
+    bool depthPrePass;
+    // variants of the lighting shaders picked for the frame and its materials
+    gps::Shader* opaqueShader;
+    gps::Shader* glassShader;
+    gps::Shader* deferredLightingShader;
+    // draws of the main view, sorted by pass and state
+    gps::RenderQueue renderQueue;
+} frames[2];
+// frame being submitted, the other one is recorded meanwhile
+FrameData* renderFrame = &frames[0];
+gps::ThreadPool threadPool;
+// one command list per worker, appended into the frame queue by the last recording job
+std::vector<gps::RenderQueue> recordLists;
+std::atomic<int> pendingRecordJobs(0);
+// passes of the frame and the pool of their transient render targets
+gps::FrameGraph frameGraph;
+// G-buffer textures in the graph of the current frame
+struct GBufferTargets {
+    gps::FrameGraphResource albedoSpec = -1;
+    gps::FrameGraphResource normal = -1;
+    gps::FrameGraphResource depth = -1;
+} gBufferTargets;
+
+// alternates both paths for a fixed number of frames and keeps the cheaper one
+const int PATH_COMPARISON_FRAMES = 480;
+const int PATH_COMPARISON_SWITCH_FRAMES = 60;
+struct RenderPathComparison {
+    bool active = false;
+    int frame = 0;
+    double cpuTime[2] = { 0.0, 0.0 };
+    double gpuTime[2] = { 0.0, 0.0 };
+    int cpuFrames[2] = { 0, 0 };
+    int gpuFrames[2] = { 0, 0 };
+} pathComparison;
+// GPU time of the scene pass, read back two frames later to avoid stalling
+GLuint scenePassQueries[2];
+RenderPath scenePassQueryPaths[2];
+bool scenePassQueryIssued[2] = { false, false };
+int scenePassQueryIndex = 0;
+
+// depth only pass before the forward shading, which then shades each pixel once
+bool depthPrePass = false;
+// fragments that reached the shading of the opaque objects, same read back delay as the timer
+GLuint shadedSampleQueries[2];
+GLuint64 lastShadedSamples = 0;
+// GL_SAMPLES_PASSED counts every sample of a multisampled target, the sample count of the pass turns it into pixels
+GLint shadedSampleQuerySamples[2] = { 1, 1 };
+GLint lastShadedSamplesPerPixel = 1;
 
 bool showDepthMap = false;
+// frames written by a trace capture
+const int PROFILER_TRACE_FRAMES = 120;
+int debugCascade = 0;
+
+enum ShadowMode { SHADOW_HARD = 0, SHADOW_EVSM = 1 };
+ShadowMode shadowMode = SHADOW_EVSM;
+// door angle and bounds the dynamic shadow casters were last rendered with
+float shadowFrontDoorRotationAngle = -1.0f;
+gps::BoundingBox shadowFrontDoorBounds;
+
+// depth pass counters of the last rendered frame
+struct ShadowPassStats {
+    int drawCalls = 0;
+    int culledMeshes = 0;
+    int triangles = 0;
+    int staticCascadeUpdates = 0;
+    int dynamicCascadeUpdates = 0;
+    int atlasTileUpdates = 0;
+} shadowPassStats;
 
 // shaders
-gps::Shader myCustomShader;
+// lighting shaders, one variant per set of features
+gps::ShaderPermutations forwardShaders;
 //gps::Shader reflectionShader;
 gps::Shader lightShader;
 gps::Shader screenQuadShader;
 gps::Shader depthMapShader;
+gps::Shader shadowMomentsShader;
+gps::Shader gBufferShader;
+gps::ShaderPermutations deferredLightingShaders;
+// shader features a surface adds to those of the frame
+struct ShaderMaterial {
+    unsigned int features;
+    int pointLights;
+};
+const ShaderMaterial OPAQUE_MATERIAL = { 0, gps::DEFAULT_POINT_LIGHTS };
+const ShaderMaterial GLASS_MATERIAL = { gps::SHADER_ALPHA_BLEND, gps::DEFAULT_POINT_LIGHTS };
+gps::Shader depthPrePassShader;
 
 gps::Shader skyBoxShader;
+// edited shader files are rebuilt in the background and swapped in once linked
+gps::ShaderWatcher shaderWatcher;
 
 GLenum glCheckError_(const char *file, int line)
 {
@@ -132,14 +323,14 @@ GLenum glCheckError_(const char *file, int line)
                 error = "INVALID_FRAMEBUFFER_OPERATION";
                 break;
         }
-		std::cout << error << " | " << file << " (" << line << ")" << std::endl;
+		GPS_LOG_ERROR("%s | %s (%d)", error.c_str(), file, line);
 	}
 	return errorCode;
 }
 #define glCheckError() glCheckError_(__FILE__, __LINE__)
 
 void windowResizeCallback(GLFWwindow* window, int width, int height) {
-	fprintf(stdout, "Window resized! New width: %d , and height: %d\n", width, height);
+	GPS_LOG_INFO("Window resized! New width: %d , and height: %d", width, height);
 	//TODO
 }
 
@@ -151,6 +342,74 @@ void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int
     if (key == GLFW_KEY_M && action == GLFW_PRESS)
         showDepthMap = !showDepthMap;
 
+    // cycle the cascade shown by the depth map view
+    if (key == GLFW_KEY_G && action == GLFW_PRESS)
+        debugCascade = (debugCascade + 1) % SHADOW_CASCADE_COUNT;
+
+    // switch between hard and filtered (EVSM) shadows
+    if (key == GLFW_KEY_V && action == GLFW_PRESS)
+        shadowMode = shadowMode == SHADOW_HARD ? SHADOW_EVSM : SHADOW_HARD;
+
+    // add or remove the grid of extra point lights
+    if (key == GLFW_KEY_X && action == GLFW_PRESS)
+        showExtraLights = !showExtraLights;
+
+    // switch between forward and deferred shading
+    if (key == GLFW_KEY_U && action == GLFW_PRESS) {
+        renderPath = renderPath == RENDER_FORWARD ? RENDER_DEFERRED : RENDER_FORWARD;
+        GPS_LOG_INFO("%s shading", renderPath == RENDER_FORWARD ? "Forward" : "Deferred");
+    }
+
+    // time both shading paths and keep the cheaper one
+    if (key == GLFW_KEY_O && action == GLFW_PRESS && !pathComparison.active) {
+        pathComparison = RenderPathComparison();
+        pathComparison.active = true;
+        GPS_LOG_INFO("Comparing the shading paths over %d frames", PATH_COMPARISON_FRAMES);
+    }
+
+    // toggle the depth pre-pass of the forward path
+    if (key == GLFW_KEY_1 && action == GLFW_PRESS) {
+        depthPrePass = !depthPrePass;
+        GPS_LOG_INFO("Depth pre-pass %s", depthPrePass ? "on" : "off");
+    }
+
+    // profile the next frames into a Chrome trace
+    if (key == GLFW_KEY_3 && action == GLFW_PRESS)
+        gps::Profiler::get().CaptureTrace(PROFILER_TRACE_FRAMES, "trace.json");
+
+    if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+        GPS_LOG_INFO("Shadow pass: %d draws, %d culled meshes, %d triangles, %d static / %d dynamic cascade updates, %d atlas tile updates",
+            shadowPassStats.drawCalls, shadowPassStats.culledMeshes, shadowPassStats.triangles,
+            shadowPassStats.staticCascadeUpdates, shadowPassStats.dynamicCascadeUpdates, shadowPassStats.atlasTileUpdates);
+        GPS_LOG_INFO("Clustered lights: %d lights, %d cluster references",
+            clusteredLights.getLightCount(), clusteredLights.getLightIndexCount());
+        gps::GLStateStats glStats = gps::GLStateCache::get().getStats();
+        GPS_LOG_INFO("GL state: %d state changes, %d redundant changes dropped, %d draws, %d triangles, %d queued items, %d culled, %d recording threads",
+            glStats.issuedCalls, glStats.skippedCalls, glStats.drawCalls, glStats.triangles,
+            renderFrame->renderQueue.getItemCount(), renderFrame->renderQueue.getCulledItemCount(), threadPool.getThreadCount());
+        gps::RenderQueue& queue = renderFrame->renderQueue;
+        GPS_LOG_INFO("Queued per pass: %d depth, %d G-buffer, %d opaque, %d unlit, %d sky, %d transparent",
+            queue.getPassItemCount(gps::RENDER_PASS_DEPTH), queue.getPassItemCount(gps::RENDER_PASS_GBUFFER),
+            queue.getPassItemCount(gps::RENDER_PASS_OPAQUE), queue.getPassItemCount(gps::RENDER_PASS_UNLIT),
+            queue.getPassItemCount(gps::RENDER_PASS_SKY), queue.getPassItemCount(gps::RENDER_PASS_TRANSPARENT));
+        // overdraw = shaded fragments per pixel, 1.0 when every pixel is shaded once
+        int pixels = myWindow.getWindowDimensions().width * myWindow.getWindowDimensions().height;
+        int samples = glm::max(lastShadedSamplesPerPixel, 1);
+        GPS_LOG_INFO("Opaque shading: %llu samples (%d per pixel), %g overdraw, depth pre-pass %s", (unsigned long long)lastShadedSamples,
+            samples, (double)lastShadedSamples / ((double)glm::max(pixels, 1) * samples),
+            depthPrePass && renderPath == RENDER_FORWARD ? "on" : "off");
+        // rolling averages, the GPU times are read a few frames late
+        std::vector<gps::ProfilerScopeStats> profile = gps::Profiler::get().getStats();
+        for (gps::ProfilerScopeStats& scope : profile) {
+            GPS_LOG_INFO("%*s%s: %g ms CPU (max %g), %g ms GPU (max %g)", 2 * scope.depth, "", scope.name.c_str(),
+                scope.cpuAverage, scope.cpuMax, scope.gpuAverage, scope.gpuMax);
+        }
+        GPS_LOG_INFO("Frames without GPU times, still in flight when read: %d", gps::Profiler::get().getDroppedFrames());
+        gps::FrameGraphStats graphStats = frameGraph.getStats();
+        GPS_LOG_INFO("Frame graph: %d passes, %d culled, %d transient textures (%d MB)", graphStats.executedPasses,
+            graphStats.culledPasses, graphStats.pooledTextures, (int)(graphStats.pooledBytes / (1024 * 1024)));
+    }
+
 	if (key >= 0 && key < 1024) {
         if (action == GLFW_PRESS) {
             pressedKeys[key] = true;
@@ -165,6 +424,9 @@ float yaw = -90.0f, pitch = 0.0f;
 bool firstMouse = true;
 
 void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
+    // the recording owns the camera
+    if (cameraReplayActive)
+        return;
 
     if (firstMouse)
     {
@@ -308,7 +570,7 @@ void processMovement() {
 }
 
 void initOpenGLWindow() {
-    myWindow.Create(1024, 768, "OpenGL Project Core");
+    myWindow.Create(windowWidth, windowHeight, "OpenGL Project Core", benchmarkMode || batchMode);
 }
 
 void setWindowCallbacks() {
@@ -322,9 +584,9 @@ void initOpenGLState() {
 	glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
 	glViewport(0, 0, myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
     glEnable(GL_FRAMEBUFFER_SRGB);
-	glEnable(GL_DEPTH_TEST); // enable depth-testing
-	glDepthFunc(GL_LESS); // depth-testing interprets a smaller value as "closer"
-	glEnable(GL_CULL_FACE); // cull face
+	gps::GLStateCache::get().SetEnabled(GL_DEPTH_TEST, true); // enable depth-testing
+	gps::GLStateCache::get().DepthFunc(GL_LESS); // depth-testing interprets a smaller value as "closer"
+	gps::GLStateCache::get().SetEnabled(GL_CULL_FACE, true); // cull face
 	glCullFace(GL_BACK); // cull back face
 	glFrontFace(GL_CCW); // GL_CCW for counter clock-wise
 }
@@ -339,91 +601,137 @@ void initModels() {
 }
 
 void initShaders() {
-    myCustomShader.loadShader("shaders/shaderStart.vert", "shaders/shaderStart.frag");
-    myCustomShader.useShaderProgram();
-    lightShader.loadShader("shaders/lightCube.vert", "shaders/lightCube.frag");
-    lightShader.useShaderProgram();
-    screenQuadShader.loadShader("shaders/screenQuad.vert", "shaders/screenQuad.frag");
-    screenQuadShader.useShaderProgram();
-    depthMapShader.loadShader("shaders/shadowMap.vert", "shaders/shadowMap.frag");
-    depthMapShader.useShaderProgram();
-    skyBoxShader.loadShader("shaders/skyBoxShader.vert", "shaders/skyBoxShader.frag");
-    skyBoxShader.useShaderProgram();
-    //reflectionShader.loadShader("shaders/reflectionShader.vert", "shaders/reflectionShader.frag");
-    //reflectionShader.useShaderProgram();
-
+    double start = glfwGetTime();
+    // the driver compiles on its own threads while the models load
+    if (GLEW_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    // the variants of both shadow modes, so switching them does not wait for the compiler
+    forwardShaders.Init("shaders/shaderStart.vert", "shaders/shaderStart.frag");
+    deferredLightingShaders.Init("shaders/fullScreenTriangle.vert", "shaders/deferredLighting.frag");
+    unsigned int shadowVariants[2] = { 0, gps::SHADER_SHADOW_EVSM };
+    for (int i = 0; i < 2; i++) {
+        unsigned int features = gps::SHADER_SHADOWS | gps::SHADER_FOG | shadowVariants[i];
+        forwardShaders.Submit(features | OPAQUE_MATERIAL.features, OPAQUE_MATERIAL.pointLights);
+        forwardShaders.Submit(features | GLASS_MATERIAL.features, GLASS_MATERIAL.pointLights);
+        deferredLightingShaders.Submit(features);
+    }
+    lightShader.Submit("shaders/lightCube.vert", "shaders/lightCube.frag");
+    screenQuadShader.Submit("shaders/screenQuad.vert", "shaders/screenQuad.frag");
+    depthMapShader.Submit("shaders/shadowMap.vert", "shaders/shadowMap.frag");
+    shadowMomentsShader.Submit("shaders/fullScreenTriangle.vert", "shaders/shadowMoments.frag");
+    gBufferShader.Submit("shaders/shaderStart.vert", "shaders/gBuffer.frag");
+    depthPrePassShader.Submit("shaders/depthPrePass.vert", "shaders/shadowMap.frag");
+    skyBoxShader.Submit("shaders/skyboxShader.vert", "shaders/skyboxShader.frag");
+    //reflectionShader.Submit("shaders/reflectionShader.vert", "shaders/reflectionShader.frag");
+
+    gps::ShaderCache& cache = gps::ShaderCache::get();
+    GPS_LOG_INFO("Shaders submitted in %.1f ms, %d from the program cache, %d compiled%s", (glfwGetTime() - start) * 1000.0,
+        cache.getHits(), cache.getMisses(), cache.isEnabled() ? "" : " (no program binary formats)");
 }
 
-void initUniforms(gps::Shader shader) {
+void initUniforms(gps::Shader& shader) {
     shader.useShaderProgram();
 
     model = glm::mat4(1.0f);
-    modelLoc = glGetUniformLocation(shader.shaderProgram, "model");
+    modelLoc = shader.getUniformLocation("model");
     glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
 
     view = myCamera.getViewMatrix();
-    viewLoc = glGetUniformLocation(shader.shaderProgram, "view");
+    viewLoc = shader.getUniformLocation("view");
     glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
 
     normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-    normalMatrixLoc = glGetUniformLocation(shader.shaderProgram, "normalMatrix");
+    normalMatrixLoc = shader.getUniformLocation("normalMatrix");
     glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
 
-    projection = glm::perspective(glm::radians(45.0f), (float)myWindow.getWindowDimensions().width / (float)myWindow.getWindowDimensions().height, 0.1f, fov);
-    projectionLoc = glGetUniformLocation(shader.shaderProgram, "projection");
+    projection = glm::perspective(glm::radians(cameraFieldOfView), (float)myWindow.getWindowDimensions().width / (float)myWindow.getWindowDimensions().height, cameraNearPlane, fov);
+    projectionLoc = shader.getUniformLocation("projection");
     glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
 
     //set the light direction (direction towards the light)
     mainLight.lightDir = glm::vec3(15.438160f, 12.868689f, -7.212670f);
     mainLight.lightRotation = glm::rotate(glm::mat4(1.0f), glm::radians(lightAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-    mainLight.lightDirLoc = glGetUniformLocation(shader.shaderProgram, "mainLightDir");
+    mainLight.lightDirLoc = shader.getUniformLocation("mainLightDir");
     glUniform3fv(mainLight.lightDirLoc, 1, glm::value_ptr(glm::inverseTranspose(glm::mat3(view * mainLight.lightRotation)) * mainLight.lightDir));
       
     //set the light direction (direction towards the light)
     secondaryLight.lightDir = glm::vec3(-10.688848f, 3.203635f, 0.789529f);
     secondaryLight.lightRotation = glm::rotate(glm::mat4(1.0f), glm::radians(lightAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-    secondaryLight.lightDirLoc = glGetUniformLocation(shader.shaderProgram, "secondaryLightDir");
-    glUniform3fv(secondaryLight.lightDirLoc, 1, glm::value_ptr(glm::inverseTranspose(glm::mat3(view * secondaryLight.lightRotation)) * secondaryLight.lightDir));
 
     //set light color
     mainLight.lightColor = glm::vec3(1.0f * mainLight.lightBrightness, 1.0f * mainLight.lightBrightness, 1.0f * mainLight.lightBrightness); //white light
-    mainLight.lightColorLoc = glGetUniformLocation(shader.shaderProgram, "mainLightColor");
+    mainLight.lightColorLoc = shader.getUniformLocation("mainLightColor");
     glUniform3fv(mainLight.lightColorLoc, 1, glm::value_ptr(mainLight.lightColor));
 
-    //set light color
-    secondaryLight.lightColor = glm::vec3(0.0f * secondaryLight.lightBrightness, 0.0f * secondaryLight.lightBrightness, 1.0f * secondaryLight.lightBrightness); //white light
-    secondaryLight.lightColorLoc = glGetUniformLocation(shader.shaderProgram, "secondaryLightColor");
-    glUniform3fv(secondaryLight.lightColorLoc, 1, glm::value_ptr(secondaryLight.lightColor));
-
     lightShader.useShaderProgram();
-    glUniformMatrix4fv(glGetUniformLocation(lightShader.shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    glUniformMatrix4fv(lightShader.getUniformLocation("projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
+    gBufferShader.useShaderProgram();
+    glUniformMatrix4fv(gBufferShader.getUniformLocation("projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
+    depthPrePassShader.useShaderProgram();
+    glUniformMatrix4fv(depthPrePassShader.getUniformLocation("projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
 }
 
-void initFBO() {
-    //Generate fbo id
-    glGenFramebuffers(1, &shadowMapFBO);
-
-    //create depth texture for FBO
-    glGenTextures(1, &depthMapTexture);
-    glBindTexture(GL_TEXTURE_2D, depthMapTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
-        SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-
-    //attach texture to FBO
-    glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMapTexture, 0);
-
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
+// every program, the variants created so far included
+std::vector<gps::Shader*> getAllShaders() {
+    std::vector<gps::Shader*> shaders = { &lightShader, &screenQuadShader, &depthMapShader, &shadowMomentsShader,
+        &gBufferShader, &depthPrePassShader, &skyBoxShader };
+    std::vector<gps::Shader*> forwardVariants = forwardShaders.getVariants();
+    std::vector<gps::Shader*> deferredVariants = deferredLightingShaders.getVariants();
+    shaders.insert(shaders.end(), forwardVariants.begin(), forwardVariants.end());
+    shaders.insert(shaders.end(), deferredVariants.begin(), deferredVariants.end());
+    return shaders;
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+void initShaderWatcher() {
+    shaderWatcher.Init();
+    std::vector<gps::Shader*> shaders = getAllShaders();
+    for (gps::Shader* shader : shaders)
+        for (const std::string& file : shader->getSourceFiles())
+            shaderWatcher.Watch(file);
+}
+
+// called between frames, while no recording job reads the program names
+void reloadChangedShaders() {
+    std::vector<gps::Shader*> shaders = getAllShaders();
+    std::vector<std::string> changed = shaderWatcher.PollChanges();
+    for (const std::string& file : changed) {
+        GPS_LOG_INFO("Recompiling the shaders using %s", file.c_str());
+        for (gps::Shader* shader : shaders)
+            if (shader->usesFile(file))
+                shader->SubmitReload();
+    }
+
+    bool swapped = false;
+    for (gps::Shader* shader : shaders) {
+        if (shader->PollReload()) {
+            swapped = true;
+            // an edit may have added an include
+            for (const std::string& file : shader->getSourceFiles())
+                shaderWatcher.Watch(file);
+        }
+    }
+    if (swapped) {
+        // the uniforms set only once, and the moments filtered by the old program
+        initUniforms(*renderFrame->opaqueShader);
+        shadowCascades.InvalidateStaticCache();
+        GPS_LOG_INFO("Shaders reloaded");
+    }
+}
+
+void initFBO() {
+    //depth texture array with one layer per cascade
+    shadowCascades.Init(SHADOW_CASCADE_RESOLUTION, SHADOW_CASCADE_COUNT);
+    //shared depth texture for the shadows of the local lights
+    shadowAtlas.Init(SHADOW_ATLAS_SIZE, SHADOW_ATLAS_MIN_TILE, SHADOW_ATLAS_MAX_TILE);
+    //light lists of the clustered shading
+    clusteredLights.Init();
+    //thin G-buffer of the deferred path
+    gBuffer.Init(myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
+    glGenQueries(2, scenePassQueries);
+    glGenQueries(2, shadedSampleQueries);
 }
 
 void initSkyBox() {
@@ -436,68 +744,40 @@ void initSkyBox() {
     
 }
 
-glm::mat4 computeMainLightSpaceTrMatrix() {
-    lightView = glm::lookAt(glm::inverseTranspose(glm::mat3(mainLight.lightRotation)) * mainLight.lightDir, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-
-    return lightProjection * lightView;
+// direction towards the main light, in world coordinates
+glm::vec3 computeMainLightDirection() {
+    return glm::inverseTranspose(glm::mat3(mainLight.lightRotation)) * mainLight.lightDir;
 }
 
-void renderLandScape(gps::Shader shader, bool depthPass) {
-    shader.useShaderProgram();
-
+glm::mat4 computeLandScapeModel() {
     glm::mat4 landScapeModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
-    landScapeModel = glm::scale(landScapeModel, glm::vec3(0.5f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(landScapeModel));
-
-    // do not send the normal matrix if we are rendering in the depth map
-    if (!depthPass) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * landScapeModel));
-        glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-
-    ground.Draw(shader);
+    return glm::scale(landScapeModel, glm::vec3(0.5f));
 }
 
-void renderWindows(gps::Shader shader, bool depthPass) {
-    shader.useShaderProgram();
-
+glm::mat4 computeWindowsModel() {
     glm::mat4 windowsModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
-    windowsModel = glm::scale(windowsModel, glm::vec3(0.5f));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(windowsModel));
-
-    // do not send the normal matrix if we are rendering in the depth map
-    if (!depthPass) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * windowsModel));
-        glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-
-    windows.Draw(shader);
+    return glm::scale(windowsModel, glm::vec3(0.5f));
 }
 
-
-void renderFrontDoor(gps::Shader shader, bool depthPass) {
-    shader.useShaderProgram();
-
+glm::mat4 computeFrontDoorModel(float rotationAngle) {
     glm::mat4 frontDoorModel = glm::mat4(1.0f);
     frontDoorModel = glm::translate(frontDoorModel, glm::vec3(-10.555405f, 2.280203f, 0.319486f));
     frontDoorModel = glm::scale(frontDoorModel, glm::vec3(0.5f));
+    return glm::rotate(frontDoorModel, glm::radians(rotationAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+}
 
+// world bounds of every shadow caster in the scene
+gps::BoundingBox computeSceneBounds() {
+    gps::BoundingBox sceneBounds = gps::transformBoundingBox(ground.getBoundingBox(), computeLandScapeModel());
+    sceneBounds = gps::mergeBoundingBoxes(sceneBounds, gps::transformBoundingBox(windows.getBoundingBox(), computeWindowsModel()));
+    sceneBounds = gps::mergeBoundingBoxes(sceneBounds, gps::transformBoundingBox(frontDoor.getBoundingBox(), renderFrame->frontDoorModel));
+    return sceneBounds;
+}
 
+void updateAnimations() {
     if (beginFrontDoorAnimation && frontDoorRotationAngle < 90.0f) {
-        frontDoorRotationAngle += 0.5f ;
+        frontDoorRotationAngle += 1.0f;
     }
-    frontDoorModel = glm::rotate(frontDoorModel, glm::radians(frontDoorRotationAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-    
-
-
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(frontDoorModel));
-
-    // do not send the normal matrix if we are rendering in the depth map
-    if (!depthPass) {
-        normalMatrix = glm::mat3(glm::inverseTranspose(view * frontDoorModel));
-        glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    frontDoor.Draw(shader);
 }
 
 
@@ -515,167 +795,636 @@ glm::vec3 P10(-35.216900f, 5.302893f, -12.221725f);
 glm::vec3 P11(-34.724472f, 5.880974f, 9.490473f);
 glm::vec3 P12(-21.979586f, 4.031127f, -4.629179f);
 
-std::vector<glm::vec3> bezierPositionPoints;
+// Bezier path of the camera animation, walked at a constant speed
+gps::CameraPath cameraPath;
+// the animated camera always looks here
+const glm::vec3 CAMERA_PATH_TARGET(-5.280864f, 3.254189f, 2.045167f);
 
-float t = 0.0f;
-float speed = 0.0006f;
+// fraction of the path length covered so far, and per simulation step
+float cameraPathDistance = 0.0f;
+float cameraPathSpeed = 0.0006f;
 
 void initControlPoints() {
-    bezierPositionPoints.push_back(P0);
-    bezierPositionPoints.push_back(P1);
-    bezierPositionPoints.push_back(P2);
-    bezierPositionPoints.push_back(P3);
-    bezierPositionPoints.push_back(P4);
-    bezierPositionPoints.push_back(P5);
-    bezierPositionPoints.push_back(P6);
-    bezierPositionPoints.push_back(P7);
-    bezierPositionPoints.push_back(P8);
-    bezierPositionPoints.push_back(P9);
-    bezierPositionPoints.push_back(P10);
-    bezierPositionPoints.push_back(P11);
-    bezierPositionPoints.push_back(P12);
-}
-
-float binomialCoefficient(int n, int k) {
-    float res = 1;
-    if (k > n - k)
-        k = n - k;
-    for (int i = 0; i < k; ++i) {
-        res *= (n - i);
-        res /= (i + 1);
-    }
-    return res;
-}
-
-glm::vec3 calculateBezierCurve(std::vector<glm::vec3> controlPoints, float t) {
-    int n = controlPoints.size() - 1;
-    glm::vec3 position(0);
-    for (int i = 0; i <= n; i++) {
-        float binom = binomialCoefficient(n, i);
-        float bernstein = binom * pow(1 - t, n - i) * pow(t, i);
-        position += bernstein * controlPoints[i];
-    }
-    return position;
+    cameraPath.Init({ P0, P1, P2, P3, P4, P5, P6, P7, P8, P9, P10, P11, P12 });
 }
 
-void renderScene() {
+void updateView() {
+    if (beginCameraAnimation) {
+        cameraPathDistance += cameraPathSpeed;
+        cameraPathDistance -= std::floor(cameraPathDistance);
 
-    depthMapShader.useShaderProgram();
-    glUniformMatrix4fv(glGetUniformLocation(depthMapShader.shaderProgram, "mainLightSpaceTrMatrix"),
-        1,
-        GL_FALSE,
-        glm::value_ptr(computeMainLightSpaceTrMatrix()));
-    glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-    glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    
-    renderLandScape(depthMapShader, true);
-    renderWindows(depthMapShader, true);
-    renderFrontDoor(depthMapShader, true);
+        // Calculate camera's position
+        myCamera.cameraPosition = cameraPath.getPosition(cameraPathDistance);
+    }
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+glm::mat4 computeViewMatrix(glm::vec3 cameraPosition) {
+    if (poseViewActive) {
+        return poseView;
+    }
+    if (!beginCameraAnimation) {
+        return myCamera.getViewMatrix(cameraPosition);
+    }
+    return glm::lookAt(cameraPosition, CAMERA_PATH_TARGET, glm::vec3(0.0f, 1.0f, 0.0f));
+}
 
-    glViewport(0, 0, myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
-    glClear(GL_COLOR_BUFFER_BIT);
+SimulationState captureSimulationState() {
+    SimulationState state;
+    state.cameraPosition = myCamera.cameraPosition;
+    state.lightAngle = lightAngle;
+    state.frontDoorRotationAngle = frontDoorRotationAngle;
+    return state;
+}
+
+// overrides the live input with the recorded camera of the step
+void applyCameraReplay() {
+    gps::CameraSample sample;
+    if (!cameraRecording.getSample(cameraReplayStep++, sample)) {
+        cameraReplayActive = false;
+        GPS_LOG_INFO("Camera replay finished after %d steps", cameraRecording.getSampleCount());
+        return;
+    }
+    myCamera.cameraPosition = sample.position;
+    yaw = sample.yaw;
+    pitch = sample.pitch;
+    myCamera.rotate(pitch, yaw);
+    beginCameraAnimation = sample.animated;
+}
 
+// run as many fixed steps as the elapsed time covers, the remainder is carried to the next frame
+void updateSimulation(double frameTime) {
+    simulationAccumulator += glm::min(frameTime, MAX_SIMULATION_LAG);
+    while (simulationAccumulator >= SIMULATION_STEP) {
+        previousSimulation = captureSimulationState();
+        processMovement();
+        updateAnimations();
+        updateView();
+        if (cameraReplayActive)
+            applyCameraReplay();
+        else if (cameraRecording.isRecording())
+            cameraRecording.Record({ myCamera.cameraPosition, yaw, pitch, beginCameraAnimation });
+        simulationAccumulator -= SIMULATION_STEP;
+    }
+    currentSimulation = captureSimulationState();
+    simulationAlpha = (float)(simulationAccumulator / SIMULATION_STEP);
+}
 
-    if (showDepthMap) {
-        screenQuadShader.useShaderProgram();
+void renderShadowCasterMesh(gps::Model3D& object, int mesh, bool visible) {
+    if (visible) {
+        object.DrawMesh(mesh, depthMapShader);
+        shadowPassStats.drawCalls++;
+        shadowPassStats.triangles += object.getMeshTriangleCount(mesh);
+    }
+    else {
+        shadowPassStats.culledMeshes++;
+    }
+}
+
+// draws only the meshes of the object that can cast a shadow onto the receivers of the cascade
+void renderShadowCasters(gps::Model3D& object, glm::mat4 objectModel, int cascade) {
+    glUniformMatrix4fv(depthMapShader.getUniformLocation("model"), 1, GL_FALSE, glm::value_ptr(objectModel));
 
+    for (int i = 0; i < object.getMeshCount(); i++) {
+        gps::BoundingBox meshBounds = gps::transformBoundingBox(object.getMeshBoundingBox(i), objectModel);
+        renderShadowCasterMesh(object, i, shadowCascades.IsCasterVisible(cascade, meshBounds));
+    }
+}
 
-        //bind the depth map
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, depthMapTexture);
-        glUniform1i(glGetUniformLocation(screenQuadShader.shaderProgram, "depthMap"), 0);
+// draws only the meshes of the object inside the range of the light
+void renderAtlasShadowCasters(gps::Model3D& object, glm::mat4 objectModel, int light) {
+    glUniformMatrix4fv(depthMapShader.getUniformLocation("model"), 1, GL_FALSE, glm::value_ptr(objectModel));
+
+    for (int i = 0; i < object.getMeshCount(); i++) {
+        gps::BoundingBox meshBounds = gps::transformBoundingBox(object.getMeshBoundingBox(i), objectModel);
+        renderShadowCasterMesh(object, i, shadowAtlas.IsCasterVisible(light, meshBounds));
+    }
+}
 
+void renderShadowAtlas(std::vector<gps::BoundingBox> movedCasters) {
+    shadowLights.clear();
+    gps::ShadowLight secondaryShadowLight;
+    secondaryShadowLight.type = gps::SHADOW_LIGHT_POINT;
+    secondaryShadowLight.position = secondaryLight.lightDir;
+    secondaryShadowLight.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    secondaryShadowLight.outerAngle = 0.0f;
+    secondaryShadowLight.range = SECONDARY_LIGHT_RANGE;
+    shadowLights.push_back(secondaryShadowLight);
 
+    shadowAtlas.Update(shadowLights, view, glm::radians(cameraFieldOfView), myWindow.getWindowDimensions().height, movedCasters);
 
+    depthMapShader.useShaderProgram();
+    for (int light = 0; light < (int)shadowLights.size(); light++) {
+        int firstTile = shadowAtlas.getFirstTile(light);
+        for (int tile = firstTile; tile >= 0 && tile < firstTile + shadowAtlas.getTileCount(light); tile++) {
+            if (!shadowAtlas.NeedsRender(tile))
+                continue;
+
+            shadowAtlas.BindTile(tile);
+            glUniformMatrix4fv(depthMapShader.getUniformLocation("mainLightSpaceTrMatrix"),
+                1,
+                GL_FALSE,
+                glm::value_ptr(shadowAtlas.getLightSpaceTrMatrix(tile)));
+            renderAtlasShadowCasters(ground, computeLandScapeModel(), light);
+            renderAtlasShadowCasters(windows, computeWindowsModel(), light);
+            renderAtlasShadowCasters(frontDoor, renderFrame->frontDoorModel, light);
+            shadowPassStats.atlasTileUpdates++;
+        }
+    }
 
-        glDisable(GL_DEPTH_TEST);
-        screenQuad.Draw(screenQuadShader);
-        glEnable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+}
 
+void renderShadowCascades(bool dynamicCastersMoved) {
+    float aspect = (float)myWindow.getWindowDimensions().width / (float)myWindow.getWindowDimensions().height;
+    shadowCascades.Update(view, glm::radians(cameraFieldOfView), aspect, cameraNearPlane, SHADOW_DISTANCE,
+        computeMainLightDirection(), computeSceneBounds());
 
+    depthMapShader.useShaderProgram();
+    for (int i = 0; i < shadowCascades.getCascadeCount(); i++) {
+        bool staticUpdated = shadowCascades.NeedsStaticUpdate(i);
+        if (!staticUpdated && !dynamicCastersMoved)
+            continue; // the cascade from the previous frame is still valid
 
+        glUniformMatrix4fv(depthMapShader.getUniformLocation("mainLightSpaceTrMatrix"),
+            1,
+            GL_FALSE,
+            glm::value_ptr(shadowCascades.getLightSpaceTrMatrix(i)));
 
+        if (staticUpdated) {
+            shadowCascades.BindStaticCascade(i);
+            renderShadowCasters(ground, computeLandScapeModel(), i);
+            renderShadowCasters(windows, computeWindowsModel(), i);
+            shadowPassStats.staticCascadeUpdates++;
+        }
+
+        shadowCascades.BindDynamicCascade(i);
+        renderShadowCasters(frontDoor, renderFrame->frontDoorModel, i);
+        shadowPassStats.dynamicCascadeUpdates++;
     }
-    else {
 
-        // final scene rendering pass (with shadows)
+    // only the cascades rendered above are filtered again
+    if (shadowMode == SHADOW_EVSM)
+        shadowCascades.UpdateMoments(shadowMomentsShader);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+}
 
-        glViewport(0, 0, myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
+void renderShadows() {
+    shadowPassStats = ShadowPassStats();
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
+    // the door is the only caster that moves without the light moving
+    std::vector<gps::BoundingBox> movedCasters;
+    gps::BoundingBox frontDoorBounds = gps::transformBoundingBox(frontDoor.getBoundingBox(), renderFrame->frontDoorModel);
+    bool dynamicCastersMoved = renderFrame->frontDoorRotationAngle != shadowFrontDoorRotationAngle;
+    if (dynamicCastersMoved) {
+        // the shadow has to be removed from where the door was and drawn where it is now
+        movedCasters.push_back(gps::mergeBoundingBoxes(shadowFrontDoorBounds, frontDoorBounds));
+    }
+    shadowFrontDoorRotationAngle = renderFrame->frontDoorRotationAngle;
+    shadowFrontDoorBounds = frontDoorBounds;
 
-        myCustomShader.useShaderProgram();
+    renderShadowCascades(dynamicCastersMoved);
+    renderShadowAtlas(movedCasters);
+}
 
-        if (!beginCameraAnimation) {
-            view = myCamera.getViewMatrix();
-            glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+// the secondary light followed by the optional grid of extra lights
+void updatePointLights() {
+    pointLights.clear();
+
+    gps::PointLight secondaryPointLight;
+    secondaryPointLight.position = secondaryLight.lightDir;
+    secondaryPointLight.range = SECONDARY_LIGHT_RANGE;
+    secondaryPointLight.color = glm::vec3(0.0f, 0.0f, 1.0f) * secondaryLight.lightBrightness;
+    secondaryPointLight.shadowTile = shadowAtlas.getFirstTile(0);
+    pointLights.push_back(secondaryPointLight);
+
+    if (showExtraLights) {
+        gps::BoundingBox sceneBounds = computeSceneBounds();
+        glm::vec2 spacing = glm::vec2(sceneBounds.max.x - sceneBounds.min.x, sceneBounds.max.z - sceneBounds.min.z) / (float)EXTRA_LIGHT_GRID;
+        for (int i = 0; i < EXTRA_LIGHT_GRID; i++) {
+            for (int j = 0; j < EXTRA_LIGHT_GRID; j++) {
+                gps::PointLight light;
+                light.position = glm::vec3(sceneBounds.min.x + (i + 0.5f) * spacing.x, EXTRA_LIGHT_HEIGHT, sceneBounds.min.z + (j + 0.5f) * spacing.y);
+                light.range = 1.5f * glm::max(spacing.x, spacing.y);
+                //cycle through a few saturated colors
+                float hue = (float)((i * EXTRA_LIGHT_GRID + j) % 6) / 6.0f * glm::two_pi<float>();
+                light.color = 0.5f + 0.5f * glm::vec3(glm::cos(hue), glm::cos(hue - 2.094f), glm::cos(hue + 2.094f));
+                light.shadowTile = -1;
+                pointLights.push_back(light);
+            }
         }
-        else {
-            // Update angle
-            t += speed;
-            t = fmod(t, 1.0f);
+    }
 
-            // Calculate camera's position
-            myCamera.cameraPosition = calculateBezierCurve(bezierPositionPoints, t);
+    float aspect = (float)myWindow.getWindowDimensions().width / (float)myWindow.getWindowDimensions().height;
+    clusteredLights.Update(pointLights, view, glm::radians(cameraFieldOfView), aspect, cameraNearPlane, fov);
+}
 
-            view = glm::lookAt(myCamera.cameraPosition, glm::vec3(-5.280864f, 3.254189f, 2.045167f), glm::vec3(0.0f, 1.0f, 0.0f));
-            glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        }
+// lights and shadow maps shared by the forward and the deferred lighting shaders
+void setLightingUniforms(gps::Shader& shader) {
+    shader.useShaderProgram();
+
+    // the variants may be created after initUniforms
+    glUniformMatrix4fv(shader.getUniformLocation("projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    glUniformMatrix4fv(shader.getUniformLocation("view"), 1, GL_FALSE, glm::value_ptr(view));
 
-        mainLight.lightRotation = glm::rotate(glm::mat4(1.0f), glm::radians(lightAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-        glUniform3fv(mainLight.lightDirLoc, 1, glm::value_ptr(glm::inverseTranspose(glm::mat3(view * mainLight.lightRotation)) * mainLight.lightDir));
+    glUniform3fv(shader.getUniformLocation("mainLightDir"), 1, glm::value_ptr(glm::inverseTranspose(glm::mat3(view * mainLight.lightRotation)) * mainLight.lightDir));
 
-        mainLight.lightColor = glm::vec3(1.0f * mainLight.lightBrightness, 1.0f * mainLight.lightBrightness, 1.0f * mainLight.lightBrightness); //white light
-        glUniform3fv(mainLight.lightColorLoc, 1, glm::value_ptr(mainLight.lightColor));
+    mainLight.lightColor = glm::vec3(1.0f * mainLight.lightBrightness, 1.0f * mainLight.lightBrightness, 1.0f * mainLight.lightBrightness); //white light
+    glUniform3fv(shader.getUniformLocation("mainLightColor"), 1, glm::value_ptr(mainLight.lightColor));
 
-        secondaryLight.lightColor = glm::vec3(0.0f * secondaryLight.lightBrightness, 0.0f * secondaryLight.lightBrightness, 1.0f * secondaryLight.lightBrightness); //white light
-        glUniform3fv(secondaryLight.lightColorLoc, 1, glm::value_ptr(secondaryLight.lightColor));
+    clusteredLights.Bind(shader, 6, myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
 
-        //bind the shadow map
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, depthMapTexture);
-        glUniform1i(glGetUniformLocation(myCustomShader.shaderProgram, "shadowMap"), 3);
+    //bind the shadow atlas
+    gps::GLStateCache::get().BindTexture(5, GL_TEXTURE_2D, shadowAtlas.getDepthTexture());
+    glUniform1i(shader.getUniformLocation("shadowAtlas"), 5);
 
-        glUniformMatrix4fv(glGetUniformLocation(myCustomShader.shaderProgram, "mainLightSpaceTrMatrix"),
+    for (int i = 0; i < shadowAtlas.getAllocatedTileCount(); i++) {
+        std::string index = "[" + std::to_string(i) + "]";
+        glUniformMatrix4fv(shader.getUniformLocation("shadowTileMatrices" + index),
             1,
             GL_FALSE,
-            glm::value_ptr(computeMainLightSpaceTrMatrix()));
-        
-        renderLandScape(myCustomShader, false);
+            glm::value_ptr(shadowAtlas.getLightSpaceTrMatrix(i)));
+        glUniform4fv(shader.getUniformLocation("shadowTileRects" + index),
+            1,
+            glm::value_ptr(shadowAtlas.getTileRect(i)));
+    }
 
-        glEnable(GL_BLEND); // transparenta
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // transparenta
-        renderWindows(myCustomShader, false);
-        glDisable(GL_BLEND); // transparenta
+    //bind the shadow cascades
+    gps::GLStateCache::get().BindTexture(3, GL_TEXTURE_2D_ARRAY, shadowCascades.getDepthTexture());
+    glUniform1i(shader.getUniformLocation("shadowMap"), 3);
 
-        renderFrontDoor(myCustomShader, false);
+    gps::GLStateCache::get().BindTexture(4, GL_TEXTURE_2D_ARRAY, shadowCascades.getMomentsTexture());
+    glUniform1i(shader.getUniformLocation("shadowMoments"), 4);
+    glUniform1f(shader.getUniformLocation("evsmExponent"), gps::EVSM_EXPONENT);
 
-        //draw a white cube around the light
+    for (int i = 0; i < shadowCascades.getCascadeCount(); i++) {
+        std::string index = "[" + std::to_string(i) + "]";
+        glUniformMatrix4fv(shader.getUniformLocation("cascadeLightSpaceTrMatrices" + index),
+            1,
+            GL_FALSE,
+            glm::value_ptr(shadowCascades.getLightSpaceTrMatrix(i)));
+        glUniform1f(shader.getUniformLocation("cascadeSplits" + index), shadowCascades.getSplitDistance(i));
+        glUniform1f(shader.getUniformLocation("cascadeBiases" + index), shadowCascades.getDepthBias(i));
+    }
+}
 
-        lightShader.useShaderProgram();
+void beginScenePassQuery() {
+    // the query issued two frames ago is normally done by now
+    int query = scenePassQueryIndex;
+    if (scenePassQueryIssued[query] && pathComparison.active) {
+        GLuint64 elapsed;
+        glGetQueryObjectui64v(scenePassQueries[query], GL_QUERY_RESULT, &elapsed);
+        pathComparison.gpuTime[scenePassQueryPaths[query]] += elapsed * 1e-6;
+        pathComparison.gpuFrames[scenePassQueryPaths[query]]++;
+    }
+    if (scenePassQueryIssued[query]) {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(shadedSampleQueries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            glGetQueryObjectui64v(shadedSampleQueries[query], GL_QUERY_RESULT, &lastShadedSamples);
+            lastShadedSamplesPerPixel = shadedSampleQuerySamples[query];
+        }
+    }
+    scenePassQueryPaths[query] = renderFrame->renderPath;
+    scenePassQueryIssued[query] = true;
+    glBeginQuery(GL_TIME_ELAPSED, scenePassQueries[query]);
+}
 
-        glUniformMatrix4fv(glGetUniformLocation(lightShader.shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+void endScenePassQuery() {
+    glEndQuery(GL_TIME_ELAPSED);
+    scenePassQueryIndex = 1 - scenePassQueryIndex;
+}
 
-        model = mainLight.lightRotation;
-        model = glm::translate(model, 1.0f * mainLight.lightDir);
-        model = glm::scale(model, glm::vec3(0.05f, 0.05f, 0.05f));
-        glUniformMatrix4fv(glGetUniformLocation(lightShader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+// copy the simulation state the frame is rendered with, blended between the last two steps
+// features of the lighting shaders that follow the render settings
+unsigned int getLightingFeatures() {
+    unsigned int features = gps::SHADER_SHADOWS | gps::SHADER_FOG;
+    if (shadowMode == SHADOW_EVSM)
+        features |= gps::SHADER_SHADOW_EVSM;
+    return features;
+}
+
+void captureFrameData(FrameData& frame) {
+    float alpha = simulationAlpha;
+    glm::vec3 cameraPosition = glm::mix(previousSimulation.cameraPosition, currentSimulation.cameraPosition, alpha);
+    float interpolatedLightAngle = glm::mix(previousSimulation.lightAngle, currentSimulation.lightAngle, alpha);
+    frame.view = computeViewMatrix(cameraPosition);
+    frame.lightRotation = glm::rotate(glm::mat4(1.0f), glm::radians(interpolatedLightAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+    frame.frontDoorRotationAngle = glm::mix(previousSimulation.frontDoorRotationAngle, currentSimulation.frontDoorRotationAngle, alpha);
+    frame.frontDoorModel = computeFrontDoorModel(frame.frontDoorRotationAngle);
+    frame.renderPath = renderPath;
+    frame.depthPrePass = depthPrePass;
+
+    unsigned int features = getLightingFeatures();
+    frame.opaqueShader = &forwardShaders.get(features | OPAQUE_MATERIAL.features, OPAQUE_MATERIAL.pointLights);
+    frame.glassShader = &forwardShaders.get(features | GLASS_MATERIAL.features, GLASS_MATERIAL.pointLights);
+    frame.deferredLightingShader = &deferredLightingShaders.get(features);
+}
+
+struct RecordJob {
+    gps::RenderPass pass;
+    bool translucent;
+    gps::Model3D* model;
+    glm::mat4 modelMatrix;
+    gps::Shader* shader;
+};
+
+// every draw of the main view, recorded on the worker threads from the frame data only;
+// visibility, sort keys and normal matrices are done there, the GL thread just replays the queue
+void recordFrame(FrameData& frame) {
+    std::vector<RecordJob> jobs;
+    if (frame.renderPath == RENDER_DEFERRED) {
+        jobs.push_back({ gps::RENDER_PASS_GBUFFER, false, &ground, computeLandScapeModel(), &gBufferShader });
+        jobs.push_back({ gps::RENDER_PASS_GBUFFER, false, &frontDoor, frame.frontDoorModel, &gBufferShader });
+    }
+    else {
+        if (frame.depthPrePass) {
+            jobs.push_back({ gps::RENDER_PASS_DEPTH, false, &ground, computeLandScapeModel(), &depthPrePassShader });
+            jobs.push_back({ gps::RENDER_PASS_DEPTH, false, &frontDoor, frame.frontDoorModel, &depthPrePassShader });
+        }
+        jobs.push_back({ gps::RENDER_PASS_OPAQUE, false, &ground, computeLandScapeModel(), frame.opaqueShader });
+        jobs.push_back({ gps::RENDER_PASS_OPAQUE, false, &frontDoor, frame.frontDoorModel, frame.opaqueShader });
+    }
 
-        lightCube.Draw(lightShader);
+    // white cube around the main light
+    glm::mat4 lightCubeModel = frame.lightRotation;
+    lightCubeModel = glm::translate(lightCubeModel, 1.0f * mainLight.lightDir);
+    lightCubeModel = glm::scale(lightCubeModel, glm::vec3(0.05f, 0.05f, 0.05f));
+    jobs.push_back({ gps::RENDER_PASS_UNLIT, false, &lightCube, lightCubeModel, &lightShader });
+
+    // blended over everything else, back to front
+    jobs.push_back({ gps::RENDER_PASS_TRANSPARENT, true, &windows, computeWindowsModel(), frame.glassShader });
+
+    frame.renderQueue.Begin(fov);
+    for (gps::RenderQueue& list : recordLists)
+        list.Begin(fov);
+
+    FrameData* recorded = &frame;
+    pendingRecordJobs = (int)jobs.size();
+    threadPool.ParallelFor((int)jobs.size(), [recorded, jobs](int index, int worker) {
+        const RecordJob& job = jobs[index];
+        recordLists[worker].SubmitModel(job.pass, job.translucent, *job.model, job.modelMatrix, *job.shader, recorded->view, projection);
+
+        // the last job gathers the command lists of all the workers
+        if (--pendingRecordJobs > 0)
+            return;
+        for (gps::RenderQueue& list : recordLists)
+            recorded->renderQueue.Append(list);
+
+        gps::RenderItem sky;
+        sky.shader = &skyBoxShader;
+        sky.model = NULL;
+        sky.mesh = 0;
+        sky.modelMatrix = glm::mat4(1.0f);
+        sky.customDraw = []() { mySkyBox.Draw(skyBoxShader, view, projection); };
+        recorded->renderQueue.Submit(gps::RENDER_PASS_SKY, false, 0, fov, sky);
+
+        recorded->renderQueue.Sort();
+    });
+}
 
+// with the target of the pass bound
+void beginShadedSampleQuery() {
+    glGetIntegerv(GL_SAMPLES, &shadedSampleQuerySamples[scenePassQueryIndex]);
+    glBeginQuery(GL_SAMPLES_PASSED, shadedSampleQueries[scenePassQueryIndex]);
+}
 
+void renderForwardScene() {
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    glViewport(0, 0, myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    if (renderFrame->depthPrePass) {
+        // lays down the depth of the opaque objects without shading them
+        depthPrePassShader.useShaderProgram();
+        glUniformMatrix4fv(depthPrePassShader.getUniformLocation("view"), 1, GL_FALSE, glm::value_ptr(view));
+        gps::GLStateCache::get().ColorMask(GL_FALSE);
+        renderFrame->renderQueue.ExecutePass(gps::RENDER_PASS_DEPTH);
+        gps::GLStateCache::get().ColorMask(GL_TRUE);
+
+        // only the closest fragment of every pixel passes, the depth is already final
+        gps::GLStateCache::get().DepthFunc(GL_EQUAL);
+        gps::GLStateCache::get().DepthMask(GL_FALSE);
     }
+
+    setLightingUniforms(*renderFrame->opaqueShader);
+    beginShadedSampleQuery();
+    renderFrame->renderQueue.ExecutePass(gps::RENDER_PASS_OPAQUE);
+    glEndQuery(GL_SAMPLES_PASSED);
+
+    gps::GLStateCache::get().DepthFunc(GL_LESS);
+    gps::GLStateCache::get().DepthMask(GL_TRUE);
+}
+
+void renderGeometryPass(GLuint albedoSpec, GLuint normal, GLuint depth) {
+    // only the opaque objects
+    gBuffer.BindForGeometry(albedoSpec, normal, depth);
+    gBufferShader.useShaderProgram();
+    glUniformMatrix4fv(gBufferShader.getUniformLocation("view"), 1, GL_FALSE, glm::value_ptr(view));
+    beginShadedSampleQuery();
+    renderFrame->renderQueue.ExecutePass(gps::RENDER_PASS_GBUFFER);
+    glEndQuery(GL_SAMPLES_PASSED);
+}
+
+void renderDeferredLighting() {
+    // one full screen triangle that also writes the scene depth back
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    glViewport(0, 0, myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gps::Shader& deferredLightingShader = *renderFrame->deferredLightingShader;
+    setLightingUniforms(deferredLightingShader);
+    glUniformMatrix4fv(deferredLightingShader.getUniformLocation("inverseProjection"), 1, GL_FALSE, glm::value_ptr(glm::inverse(projection)));
+    glUniformMatrix4fv(deferredLightingShader.getUniformLocation("inverseView"), 1, GL_FALSE, glm::value_ptr(glm::inverse(view)));
+    gBuffer.BindTextures(deferredLightingShader, 9);
+    gps::GLStateCache::get().DepthFunc(GL_ALWAYS);
+    gBuffer.DrawFullScreen();
+    gps::GLStateCache::get().DepthFunc(GL_LESS);
+}
+
+void renderDepthMapView() {
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    glViewport(0, 0, myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    screenQuadShader.useShaderProgram();
+
+    //bind the depth map
+    gps::GLStateCache::get().BindTexture(0, GL_TEXTURE_2D_ARRAY, shadowCascades.getDepthTexture());
+    glUniform1i(screenQuadShader.getUniformLocation("depthMap"), 0);
+    glUniform1i(screenQuadShader.getUniformLocation("depthMapLayer"), debugCascade);
+
+    gps::GLStateCache::get().SetEnabled(GL_DEPTH_TEST, false);
+    screenQuad.Draw(screenQuadShader);
+    gps::GLStateCache::get().SetEnabled(GL_DEPTH_TEST, true);
+
     mySkyBox.Draw(skyBoxShader, view, projection);
 }
 
+// called once per frame while the shading paths are being compared
+void updatePathComparison(double frameTime) {
+    if (!pathComparison.active)
+        return;
+
+    // the first frame after a switch pays for the change of path
+    if (pathComparison.frame % PATH_COMPARISON_SWITCH_FRAMES != 0) {
+        pathComparison.cpuTime[renderPath] += frameTime * 1000.0;
+        pathComparison.cpuFrames[renderPath]++;
+    }
+    pathComparison.frame++;
+    if (pathComparison.frame % PATH_COMPARISON_SWITCH_FRAMES == 0)
+        renderPath = renderPath == RENDER_FORWARD ? RENDER_DEFERRED : RENDER_FORWARD;
+
+    if (pathComparison.frame < PATH_COMPARISON_FRAMES)
+        return;
+
+    pathComparison.active = false;
+    const char* names[2] = { "Forward", "Deferred" };
+    double gpuAverage[2];
+    for (int path = 0; path < 2; path++) {
+        double cpuAverage = pathComparison.cpuTime[path] / glm::max(pathComparison.cpuFrames[path], 1);
+        gpuAverage[path] = pathComparison.gpuTime[path] / glm::max(pathComparison.gpuFrames[path], 1);
+        GPS_LOG_INFO("%s: %g ms frame, %g ms scene pass", names[path], cpuAverage, gpuAverage[path]);
+    }
+    renderPath = gpuAverage[RENDER_DEFERRED] < gpuAverage[RENDER_FORWARD] ? RENDER_DEFERRED : RENDER_FORWARD;
+    GPS_LOG_INFO("Keeping %s shading", names[renderPath]);
+}
+
+// the passes of the frame, the graph drops the ones that do not reach the screen and orders the rest
+void buildFrameGraph() {
+    frameGraph.Reset();
+
+    gps::FrameGraphResource backBuffer = frameGraph.Import("backBuffer", 0, true);
+    gps::FrameGraphResource cascades = frameGraph.Import("shadowCascades", shadowCascades.getDepthTexture(), false);
+    gps::FrameGraphResource atlas = frameGraph.Import("shadowAtlas", shadowAtlas.getDepthTexture(), false);
+    gps::FrameGraphResource clusters = frameGraph.Import("lightClusters", 0, false);
+
+    frameGraph.AddPass("Shadows",
+        [&](gps::FrameGraphBuilder& builder) {
+            builder.Write(cascades);
+            builder.Write(atlas);
+        },
+        [](gps::FrameGraph&) { renderShadows(); });
+
+    // the secondary light and any extra point lights go through the clusters
+    frameGraph.AddPass("LightClusters",
+        [&](gps::FrameGraphBuilder& builder) {
+            // the secondary light needs its tile in the atlas
+            builder.Read(atlas);
+            builder.Write(clusters);
+        },
+        [](gps::FrameGraph&) { updatePointLights(); });
+
+    if (showDepthMap) {
+        // shows the cascades as they were last rendered, so the shadow passes are culled meanwhile
+        frameGraph.AddPass("DepthMapView",
+            [&](gps::FrameGraphBuilder& builder) { builder.Write(backBuffer); },
+            [](gps::FrameGraph&) { renderDepthMapView(); });
+        return;
+    }
+
+    if (renderFrame->renderPath == RENDER_DEFERRED) {
+        // transient, the forward path keeps no G-buffer memory
+        frameGraph.AddPass("GBuffer",
+            [&](gps::FrameGraphBuilder& builder) {
+                gBufferTargets.albedoSpec = builder.Write(builder.Create("gAlbedoSpec", gBuffer.getAttachmentDesc(gps::GBUFFER_ALBEDO_SPEC)));
+                gBufferTargets.normal = builder.Write(builder.Create("gNormal", gBuffer.getAttachmentDesc(gps::GBUFFER_NORMAL)));
+                gBufferTargets.depth = builder.Write(builder.Create("gDepth", gBuffer.getAttachmentDesc(gps::GBUFFER_DEPTH)));
+            },
+            [](gps::FrameGraph& graph) {
+                beginScenePassQuery();
+                renderGeometryPass(graph.getTexture(gBufferTargets.albedoSpec),
+                    graph.getTexture(gBufferTargets.normal),
+                    graph.getTexture(gBufferTargets.depth));
+            });
+
+        frameGraph.AddPass("DeferredLighting",
+            [&](gps::FrameGraphBuilder& builder) {
+                builder.Read(gBufferTargets.albedoSpec);
+                builder.Read(gBufferTargets.normal);
+                builder.Read(gBufferTargets.depth);
+                builder.Read(cascades);
+                builder.Read(atlas);
+                builder.Read(clusters);
+                builder.Write(backBuffer);
+            },
+            [](gps::FrameGraph&) {
+                renderDeferredLighting();
+                endScenePassQuery();
+            });
+    }
+    else {
+        frameGraph.AddPass("ForwardOpaque",
+            [&](gps::FrameGraphBuilder& builder) {
+                builder.Read(cascades);
+                builder.Read(atlas);
+                builder.Read(clusters);
+                builder.Write(backBuffer);
+            },
+            [](gps::FrameGraph&) {
+                beginScenePassQuery();
+                renderForwardScene();
+                endScenePassQuery();
+            });
+    }
+
+    frameGraph.AddPass("Unlit",
+        [&](gps::FrameGraphBuilder& builder) { builder.Write(backBuffer); },
+        [](gps::FrameGraph&) {
+            lightShader.useShaderProgram();
+            glUniformMatrix4fv(lightShader.getUniformLocation("view"), 1, GL_FALSE, glm::value_ptr(view));
+            renderFrame->renderQueue.ExecutePass(gps::RENDER_PASS_UNLIT);
+        });
+
+    frameGraph.AddPass("Sky",
+        [&](gps::FrameGraphBuilder& builder) { builder.Write(backBuffer); },
+        [](gps::FrameGraph&) { renderFrame->renderQueue.ExecutePass(gps::RENDER_PASS_SKY); });
+
+    // the windows are blended with the forward shader in both paths
+    frameGraph.AddPass("Transparent",
+        [&](gps::FrameGraphBuilder& builder) {
+            builder.Read(cascades);
+            builder.Read(atlas);
+            builder.Read(clusters);
+            builder.Write(backBuffer);
+        },
+        [](gps::FrameGraph&) {
+            setLightingUniforms(*renderFrame->glassShader);
+            gps::GLStateCache::get().SetEnabled(GL_BLEND, true); // transparenta
+            gps::GLStateCache::get().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // transparenta
+            renderFrame->renderQueue.ExecutePass(gps::RENDER_PASS_TRANSPARENT);
+            gps::GLStateCache::get().SetEnabled(GL_BLEND, false); // transparenta
+        });
+}
+
+// submits the frame recorded during the previous iteration
+void renderScene() {
+
+    gps::GLStateCache::get().ResetStats();
+    view = renderFrame->view;
+    mainLight.lightRotation = renderFrame->lightRotation;
+
+    buildFrameGraph();
+    frameGraph.Compile();
+    frameGraph.Execute();
+}
+
 void cleanup() {
-    glDeleteTextures(1, &depthMapTexture);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glDeleteFramebuffers(1, &shadowMapFBO);
+    if (benchmarkMode)
+        benchmark.Delete();
+    if (sceneFramebuffer != 0)
+        offscreenTarget.Delete();
+    shadowCascades.Delete();
+    shadowAtlas.Delete();
+    clusteredLights.Delete();
+    gBuffer.Delete();
+    frameGraph.Delete();
+    threadPool.Delete();
+    shaderWatcher.Delete();
+    cameraRecording.EndRecording();
+    gps::Profiler::get().Delete();
+    glDeleteQueries(2, scenePassQueries);
+    glDeleteQueries(2, shadedSampleQueries);
     myWindow.Delete();
     //cleanup code for your own data
 }
@@ -686,27 +1435,287 @@ void initLightProps() {
 }
 
 
+// record frame N + 1 on the workers while frame N is submitted here
+void renderPipelinedFrame() {
+    FrameData* recordedFrame = renderFrame == &frames[0] ? &frames[1] : &frames[0];
+    {
+        gps::ProfileScope scope("Record");
+        captureFrameData(*recordedFrame);
+        recordFrame(*recordedFrame);
+    }
+    {
+        gps::ProfileScope scope("Submit");
+        renderScene();
+    }
+    {
+        // time the main thread waits for the workers
+        gps::ProfileScope scope("RecordWait");
+        threadPool.Wait();
+    }
+    renderFrame = recordedFrame;
+}
+
+// one pose per line: position and target, blank lines and lines starting with # are skipped
+std::vector<CameraPose> loadCameraPoses(std::string path) {
+    std::vector<CameraPose> poses;
+    std::ifstream file(path);
+    if (!file) {
+        GPS_LOG_ERROR("Could not open the pose file %s", path.c_str());
+        return poses;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream values(line);
+        CameraPose pose;
+        if (values >> pose.position.x >> pose.position.y >> pose.position.z >> pose.target.x >> pose.target.y >> pose.target.z)
+            poses.push_back(pose);
+        else
+            GPS_LOG_WARNING("Skipping the pose line: %s", line.c_str());
+    }
+    return poses;
+}
+
+// evenly spaced around the center of the scene, looking at it from slightly above
+std::vector<CameraPose> buildTurntablePoses(int count) {
+    gps::BoundingBox sceneBounds = computeSceneBounds();
+    glm::vec3 center = (sceneBounds.min + sceneBounds.max) * 0.5f;
+    glm::vec3 extent = sceneBounds.max - sceneBounds.min;
+    float radius = 0.6f * glm::max(extent.x, extent.z);
+
+    std::vector<CameraPose> poses;
+    for (int i = 0; i < count; i++) {
+        float angle = glm::two_pi<float>() * i / count;
+        CameraPose pose;
+        pose.position = center + glm::vec3(radius * glm::cos(angle), 0.25f * radius, radius * glm::sin(angle));
+        pose.target = center;
+        poses.push_back(pose);
+    }
+    return poses;
+}
+
+// the camera animation at a constant speed, one lap over all the frames
+std::vector<CameraPose> buildFlythroughPoses(int count) {
+    std::vector<glm::vec3> positions = cameraPath.SamplePositions(count);
+    std::vector<CameraPose> poses(count);
+    for (int i = 0; i < count; i++) {
+        poses[i].position = positions[i];
+        poses[i].target = CAMERA_PATH_TARGET;
+    }
+    return poses;
+}
+
+int runBatchRender() {
+    std::vector<CameraPose> poses;
+    if (batchFlythroughFrames > 0)
+        poses = buildFlythroughPoses(batchFlythroughFrames);
+    else if (batchTurntableFrames > 0)
+        poses = buildTurntablePoses(batchTurntableFrames);
+    else
+        poses = loadCameraPoses(batchPosesPath);
+    if (poses.empty()) {
+        GPS_LOG_ERROR("No camera poses to render");
+        return EXIT_FAILURE;
+    }
+
+    gps::FrameCapture capture;
+    capture.Init(offscreenTarget.getWidth(), offscreenTarget.getHeight(), batchImageFormat, batchOutputDirectory, batchSyncReadback);
+    for (size_t i = 0; i < poses.size(); i++) {
+        poseView = glm::lookAt(poses[i].position, poses[i].target, glm::vec3(0.0f, 1.0f, 0.0f));
+        poseViewActive = true;
+
+        // the first frame records the pose, the second one submits it
+        for (int frame = 0; frame < 2; frame++) {
+            gps::Profiler::get().BeginFrame();
+            renderPipelinedFrame();
+            gps::Profiler::get().EndFrame();
+        }
+
+        capture.Capture(offscreenTarget.getFramebuffer());
+        capture.Poll();
+    }
+    capture.Finish();
+
+    int captured = capture.getCapturedFrames();
+    GPS_LOG_INFO("Captured %d frames, %.1f frames/s (%s), render thread waited on the encoders %d times",
+        captured, capture.getFramesPerSecond(), batchSyncReadback ? "synchronous" : "PBO ring", capture.getBackpressureWaits());
+    capture.Delete();
+    return captured == (int)poses.size() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void parseArguments(int argc, const char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--benchmark") == 0) {
+            benchmarkMode = true;
+        }
+        else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            benchmarkFrames = glm::max(std::atoi(argv[++i]), 1);
+            benchmarkFramesSet = true;
+        }
+        else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            benchmarkOutput = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            gps::LogLevel level;
+            if (gps::parseLogLevel(argv[++i], level))
+                gps::Logger::get().setLevel(level);
+            else
+                GPS_LOG_WARNING("Unknown log level %s", argv[i]);
+        }
+        else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            cameraRecordPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            cameraReplayPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--poses") == 0 && i + 1 < argc) {
+            batchMode = true;
+            batchPosesPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--turntable") == 0 && i + 1 < argc) {
+            batchMode = true;
+            batchTurntableFrames = glm::max(std::atoi(argv[++i]), 1);
+        }
+        else if (std::strcmp(argv[i], "--flythrough") == 0 && i + 1 < argc) {
+            batchMode = true;
+            batchFlythroughFrames = glm::max(std::atoi(argv[++i]), 1);
+        }
+        else if (std::strcmp(argv[i], "--output-dir") == 0 && i + 1 < argc) {
+            batchOutputDirectory = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            if (!gps::parseImageFormat(argv[++i], batchImageFormat))
+                GPS_LOG_WARNING("Unknown image format %s, writing %s", argv[i], gps::getImageExtension(batchImageFormat).c_str());
+        }
+        else if (std::strcmp(argv[i], "--sync-readback") == 0) {
+            batchSyncReadback = true;
+        }
+        else if (std::strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+            windowWidth = glm::max(std::atoi(argv[++i]), 1);
+        }
+        else if (std::strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+            windowHeight = glm::max(std::atoi(argv[++i]), 1);
+        }
+    }
+}
+
+// without a visible window the final passes draw into renderbuffers
+void initOffscreenTarget() {
+    offscreenTarget.Init(myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
+    sceneFramebuffer = offscreenTarget.getFramebuffer();
+}
+
+int getSimulationStepsPerSecond() {
+    return (int)(1.0 / SIMULATION_STEP + 0.5);
+}
+
+void initCameraRecording() {
+    if (!cameraReplayPath.empty()) {
+        if (!cameraRecording.Load(cameraReplayPath))
+            return;
+        cameraReplayActive = true;
+        cameraReplayStep = 0;
+        if (cameraRecording.getStepsPerSecond() != getSimulationStepsPerSecond())
+            GPS_LOG_WARNING("The recording has %d steps per second, replaying at %d",
+                cameraRecording.getStepsPerSecond(), getSimulationStepsPerSecond());
+        // one step per benchmark frame, the warmup included
+        if (benchmarkMode && !benchmarkFramesSet)
+            benchmarkFrames = glm::max(cameraRecording.getSampleCount() - BENCHMARK_WARMUP_FRAMES, 1);
+        GPS_LOG_INFO("Replaying %d camera steps from %s", cameraRecording.getSampleCount(), cameraReplayPath.c_str());
+        if (!cameraRecordPath.empty())
+            GPS_LOG_WARNING("Not recording while replaying");
+    }
+    else if (!cameraRecordPath.empty()) {
+        cameraRecording.BeginRecording(cameraRecordPath, getSimulationStepsPerSecond());
+    }
+}
+
+// a camera path that covers the whole curve over the measured frames, or the replayed session
+void initBenchmark() {
+    if (cameraReplayActive) {
+        benchmark.Init(benchmarkFrames, BENCHMARK_WARMUP_FRAMES);
+        return;
+    }
+
+    // the warmup frames end right where the measured loop starts
+    beginCameraAnimation = true;
+    cameraPathSpeed = 1.0f / benchmarkFrames;
+    cameraPathDistance = (float)fmod(1.0 - BENCHMARK_WARMUP_FRAMES * (double)cameraPathSpeed, 1.0);
+    if (cameraPathDistance < 0.0f)
+        cameraPathDistance += 1.0f;
+    myCamera.cameraPosition = cameraPath.getPosition(cameraPathDistance);
+
+    benchmark.Init(benchmarkFrames, BENCHMARK_WARMUP_FRAMES);
+}
+
+void writeBenchmarkReport() {
+    benchmark.Finish();
+    std::string json = benchmark.getJson((const char*)glGetString(GL_RENDERER),
+        myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
+
+    std::ofstream file(benchmarkOutput);
+    file << json;
+    // the report itself is data on stdout, not a log message; the log goes first so the two do not interleave
+    gps::Logger::get().Flush();
+    std::fwrite(json.data(), 1, json.size(), stdout);
+    std::fflush(stdout);
+    GPS_LOG_INFO("Benchmark written to %s", benchmarkOutput.c_str());
+}
+
 int main(int argc, const char * argv[]) {
 
+    parseArguments(argc, argv);
+    // the Y4M stream gets stdout to itself, everything printed goes to stderr
+    if (batchMode && batchImageFormat == gps::IMAGE_Y4M && batchOutputDirectory == "-")
+        gps::FrameCapture::ReserveStdout();
+
     try {
         initOpenGLWindow();
     } catch (const std::exception& e) {
-        std::cerr << e.what() << std::endl;
+        GPS_LOG_ERROR("%s", e.what());
         return EXIT_FAILURE;
     }
 
     initControlPoints();
     initOpenGLState();
     initLightProps();
+    // submitted first, the programs are checked on their first use
+	initShaders();
     initSkyBox();
 	initModels();
-	initShaders();
-	initUniforms(myCustomShader);
+	initUniforms(forwardShaders.get(getLightingFeatures()));
 	//initUniforms(reflectionShader);
     setWindowCallbacks();
     initFBO();
 
+    if (benchmarkMode || batchMode)
+        initOffscreenTarget();
+    if (!batchMode)
+        initCameraRecording();
+    if (benchmarkMode)
+        initBenchmark();
+    else if (!batchMode)
+        initShaderWatcher();
+
+    threadPool.Init(0);
+    recordLists.resize(threadPool.getThreadCount());
+    // the first frame has nothing to overlap with
+    previousSimulation = captureSimulationState();
+    currentSimulation = previousSimulation;
+    captureFrameData(frames[0]);
+    recordFrame(frames[0]);
+    threadPool.Wait();
+
 	glCheckError();
+
+    if (batchMode) {
+        int result = runBatchRender();
+        cleanup();
+        return result;
+    }
+
 	// application loop
     
     // FPS
@@ -718,18 +1727,49 @@ int main(int argc, const char * argv[]) {
         // FPS
         step++;
 
-        processMovement();
-        renderScene();
+        double currentFrameTime = glfwGetTime();
+        double dFrameTime = currentFrameTime - lastFrameTime;
+        lastFrameTime = currentFrameTime;
+
+        gps::Profiler& profiler = gps::Profiler::get();
+        profiler.BeginFrame();
+
+        {
+            // exactly one simulation step per frame keeps the benchmark deterministic
+            gps::ProfileScope scope("Simulation");
+            if (benchmarkMode) {
+                benchmark.BeginFrame();
+                updateSimulation(SIMULATION_STEP);
+            }
+            else {
+                updateSimulation(dFrameTime);
+            }
+        }
+
+        if (!benchmarkMode)
+            reloadChangedShaders();
+
+        renderPipelinedFrame();
+        profiler.EndFrame();
+
+        if (benchmarkMode) {
+            gps::GLStateStats glStats = gps::GLStateCache::get().getStats();
+            benchmark.EndFrame(glStats.drawCalls, glStats.triangles);
+            glFlush();
+            if (benchmark.IsFinished()) {
+                writeBenchmarkReport();
+                break;
+            }
+            glfwPollEvents();
+            continue;
+        }
+
 		glfwPollEvents();
 		glfwSwapBuffers(myWindow.getWindow());
 
         glCheckError();
 
-
-
-        double currentFrameTime = glfwGetTime();
-        double dFrameTime = currentFrameTime - lastFrameTime;
-        lastFrameTime = currentFrameTime;
+        updatePathComparison(dFrameTime);
 
         dSum += dFrameTime;
         if (step >= 20) {